@@ -55,7 +55,7 @@ This macro for name = xyz would create folowing objects:
     }
 
 PIKANGO_HANDLE_FWD(graphics_pipeline);
-//PIKANGO_HANDLE_FWD(compute_pipeline)
+PIKANGO_HANDLE_FWD(compute_pipeline);
 PIKANGO_HANDLE_FWD(command_buffer);
 PIKANGO_HANDLE_FWD(fence);
 PIKANGO_HANDLE_FWD(shader);
@@ -111,7 +111,15 @@ namespace pikango
     {
         vertex,
         pixel,
-        geometry
+        geometry,
+        compute
+    };
+
+    enum class shader_compile_status : unsigned char
+    {
+        compiling,
+        ready,
+        failed
     };
 
     enum class texture_type : unsigned char
@@ -195,6 +203,42 @@ namespace pikango
         depth,
         stencil
     };
+
+    enum class command_buffer_usage : unsigned char
+    {
+        one_time,   //buffer is rerecorded before every submission
+        reusable    //buffer is recorded once and then submitted many times
+    };
+
+    enum class image_access : unsigned char
+    {
+        read_only,
+        write_only,
+        read_write
+    };
+
+    //Operations that have to see the storage buffer and image writes issued before the barrier
+    //Scopes can be combined with |
+    enum class memory_barrier_scope : unsigned short
+    {
+        vertex_attributes   = 1 << 0,
+        index_buffer        = 1 << 1,
+        uniform             = 1 << 2,
+        texture_fetch       = 1 << 3,
+        image_access        = 1 << 4,
+        indirect_arguments  = 1 << 5,
+        pixel_buffer        = 1 << 6,
+        texture_update      = 1 << 7,
+        buffer_update       = 1 << 8,
+        frame_buffer        = 1 << 9,
+        storage_buffer      = 1 << 10,
+        all                 = 0x7ff
+    };
+
+    inline memory_barrier_scope operator|(memory_barrier_scope a, memory_barrier_scope b)
+    {
+        return memory_barrier_scope((unsigned short)a | (unsigned short)b);
+    }
 }
 
 /*
@@ -279,14 +323,48 @@ namespace pikango
         depth_stencil_pipeline_info     depth_stencil_info;
     };
 
+    struct compute_pipeline_create_info
+    {
+        shader_handle compute_shader;
+    };
+
     struct command_buffer_create_info
     {  
+        command_buffer_usage usage = command_buffer_usage::one_time;
+
+        //merge the consecutive draw_indexed commands into multi draws when the recording ends
+        bool coalesce_draws = false;
     };
 
     struct fence_create_info
     {
     };
 
+    //Layouts of the arguments read by the indirect draws
+    struct draw_indirect_arguments
+    {
+        uint32_t vertices_count;
+        uint32_t instances_count;
+        uint32_t vertices_buffer_offset_index;
+        uint32_t instances_id_values_offset;
+    };
+
+    struct draw_indexed_indirect_arguments
+    {
+        uint32_t indices_count;
+        uint32_t instances_count;
+        uint32_t indicies_buffer_offset_index;
+        int32_t  indicies_values_offset;
+        uint32_t instances_id_values_offset;
+    };
+
+    struct dispatch_indirect_arguments
+    {
+        uint32_t groups_x;
+        uint32_t groups_y;
+        uint32_t groups_z;
+    };
+
     struct buffer_create_info
     {
         size_t                  buffer_size_bytes;
@@ -321,6 +399,25 @@ namespace pikango
         const char*  source;
     };
 
+    struct shader_define
+    {
+        std::string name;
+        std::string value;
+    };
+
+    //Finds the source of a file included with #include "name" or #include <name>
+    //returns false if there is no such file
+    using shader_include_resolver = bool(*)(const std::string& include_name, std::string& included_source);
+
+    //Variants with the same final source share one shader
+    struct shader_variant_create_info
+    {
+        shader_type                 type;
+        const char*                 source;
+        std::vector<shader_define>  defines;
+        shader_include_resolver     include_resolver = nullptr;
+    };
+
     struct frame_buffer_create_info
     {
     };
@@ -335,9 +432,35 @@ namespace pikango
 {
     using error_notification_callback = void(*)(const char* notification);
 
+    //How the execution thread waits for work once all the queues are empty
+    //spinning and yielding lower the submit-to-execute latency at the cost of idle cpu time
+    enum class execution_thread_wait_policy : unsigned char
+    {
+        park,               //sleep right away, until a new work is submitted
+        spin_then_park,     //busy wait for execution_thread_spin_microseconds, then sleep
+        yield_then_park     //yield the cpu for execution_thread_spin_microseconds, then sleep
+    };
+
     struct initialize_library_cpu_settings
     {
         error_notification_callback error_callback = nullptr;
+
+        execution_thread_wait_policy execution_thread_wait = execution_thread_wait_policy::spin_then_park;
+        size_t execution_thread_spin_microseconds = 50;
+
+        //directory where compiled shaders are stored and loaded from on the next runs
+        //has to exist, empty disables the cache
+        std::string program_binary_cache_directory;
+
+        //While several queues have work, each gets a share of the execution time proportional to its weight
+        //The execution thread reconsiders which queue to execute after each time slice,
+        //and a queue with work is never left waiting longer than the max wait
+        size_t general_queue_weight = 4;
+        size_t compute_queue_weight = 2;
+        size_t transfer_queue_weight = 1;
+
+        size_t queue_time_slice_microseconds = 1000;
+        size_t queue_max_wait_microseconds = 8000;
     };
 
     std::string initialize_library_cpu(const initialize_library_cpu_settings& settings);
@@ -350,6 +473,22 @@ namespace pikango
 {
     using opengl_thread_task = void(*)(std::vector<std::any>&);
     void OPENGL_ONLY_execute_on_context_thread(opengl_thread_task task, std::vector<std::any>&& args);
+
+    //Runs the transfer queue on its own thread, the task is executed on it first and has to make current
+    //a context sharing objects with the main one, which is not current on any other thread
+    //Only buffer and texture writes and copies can be submitted to the transfer queue afterwards
+    //Call after initialize_library_gpu, the thread is stopped by terminate
+    void OPENGL_ONLY_start_transfer_thread(opengl_thread_task make_context_current, std::vector<std::any>&& args);
+
+    //Calls changing the context state since the initialization:
+    //issued ones reached the driver, filtered ones would not change anything and were skipped
+    struct OPENGL_ONLY_state_cache_report
+    {
+        uint64_t issued_calls;
+        uint64_t filtered_calls;
+    };
+
+    OPENGL_ONLY_state_cache_report OPENGL_ONLY_get_state_cache_report();
 }
 #endif
 
@@ -366,8 +505,27 @@ namespace pikango
 
     void wait_queue_empty(queue_type type, size_t queue_index);
     void wait_all_queues_empty();
+
+    //Totals since the initialization, except for the max wait which is since the previous call
+    //Wait is the time from the submission to the start of the execution
+    struct queue_metrics
+    {
+        size_t      depth;                  //submissions not executed yet
+        uint64_t    executed_tasks;
+        uint64_t    wait_microseconds;
+        uint64_t    max_wait_microseconds;
+        uint64_t    busy_microseconds;      //time spent executing the submissions
+    };
+
+    queue_metrics get_queue_metrics(queue_type type, size_t queue_index);
+
     void submit_command_buffer(command_buffer_handle target, queue_type type, size_t queue_index);
     void submit_command_buffer_with_fence(command_buffer_handle target, queue_type type, size_t queue_index, fence_handle wait_fence);
+
+    //Command buffers are executed in the given order, one right after another,
+    //without any other work submitted to the queue in between
+    void submit_command_buffers(const std::vector<command_buffer_handle>& targets, queue_type type, size_t queue_index);
+    void submit_command_buffers_with_fence(const std::vector<command_buffer_handle>& targets, queue_type type, size_t queue_index, fence_handle wait_fence);
 }
 
 //Getters
@@ -385,23 +543,64 @@ namespace pikango
 namespace pikango
 {
     void configure_command_buffer(command_buffer_handle target, queue_type target_queue_type);
+    //Blocks until the earlier submissions of the buffer have finished executing on the cpu
     void begin_command_buffer_recording(command_buffer_handle target);
     void end_command_buffer_recording(command_buffer_handle target);
+
+    struct command_memory_report
+    {
+        const char* command_name;
+        size_t      commands_count;
+        size_t      bytes;
+    };
+
+    struct command_buffer_memory_report
+    {
+        size_t commands_count;
+        size_t stream_bytes;        //bytes occupied by the recorded commands
+        size_t reserved_bytes;      //bytes allocated for the commands stream and the small written data
+        size_t retained_resources;  //handles kept alive by the recorded commands
+        size_t payload_bytes;       //bytes of small written data copied into the command buffer
+        size_t staging_bytes;       //bytes of larger written data copied to the staging memory
+        size_t coalesced_draws;     //draw_indexed commands merged into multi draws
+
+        std::vector<command_memory_report> commands;
+    };
+
+    command_buffer_memory_report get_command_buffer_memory_report(command_buffer_handle target);
 }
 
 //Fences
 namespace pikango
 {
+    //Fences get signaled once the gpu finishes the work submitted with them
+    //fence that was never submitted counts as signaled
+    bool is_fence_signaled(fence_handle target);
+
     void wait_fence(fence_handle target);
+    bool wait_fence(fence_handle target, uint64_t timeout_nanoseconds); //returns false on timeout
     void wait_multiple_fences(std::vector<fence_handle> targets);
 }
 
+//Shaders
+namespace pikango
+{
+    //Defines are inserted after the #version directive and includes are resolved before compiling
+    shader_handle new_shader_variant(const shader_variant_create_info& info);
+
+    //Shaders are compiled in the background, new_shader does not wait for it
+    //compilation errors are reported to the error callback
+    shader_compile_status get_shader_compile_status(shader_handle target);
+    void await_shaders_ready(const std::vector<shader_handle>& targets);
+}
+
 //Buffer
 namespace pikango
 {
     size_t get_buffer_size(buffer_handle target);
 }
 
+//Written data is copied when the command is recorded, it can be freed right after the call
 namespace pikango::cmd
 {
     void write_buffer(
@@ -429,6 +628,9 @@ namespace pikango::cmd
 //Texture Buffers
 namespace pikango::cmd
 {
+    //Data is copied when the command is recorded, rows are aligned to 4 bytes
+    //Larger data is uploaded from a pixel buffer in the background, a fence signaled
+    //by the submission of the command buffer tells when the texture was written
     void write_texture_buffer(
         texture_buffer_handle   target,
         size_t                  mipmap_layer,
@@ -466,6 +668,7 @@ namespace pikango
 namespace pikango::cmd
 {
     void bind_graphics_pipeline(graphics_pipeline_handle pipeline);
+    void bind_compute_pipeline(compute_pipeline_handle pipeline);
 
     void bind_frame_buffer(frame_buffer_handle frame_buffer);
 
@@ -484,6 +687,24 @@ namespace pikango::cmd
         size_t size,
         size_t offset
     );
+
+    void bind_storage_buffer(
+        buffer_handle storage_buffer,
+        size_t slot,
+        size_t size,
+        size_t offset
+    );
+
+    //Arrays, 3d textures and cubemaps are bound with all their layers
+    void bind_image(
+        texture_buffer_handle buffer,
+        size_t slot,
+        size_t mipmap_layer,
+        image_access access
+    );
+
+    //Makes the storage buffer and image writes of the previous draws and dispatches visible to the given operations
+    void memory_barrier(memory_barrier_scope scopes);
 }
 
 //Drawing Related Commands
@@ -520,6 +741,46 @@ namespace pikango::cmd
         size_t          instances_count,
         size_t          instances_id_values_offset
     );
+
+    //Indirect draws read their arguments from the buffer when they execute, so the gpu can write them too
+    //The offset is in bytes, the stride of multi draws is 0 when the arguments are tightly packed
+    void draw_indirect(
+        draw_primitive  primitive,
+        buffer_handle   arguments_buffer,
+        size_t          arguments_offset
+    );
+
+    void draw_indexed_indirect(
+        draw_primitive  primitive,
+        buffer_handle   arguments_buffer,
+        size_t          arguments_offset
+    );
+
+    void multi_draw_indirect(
+        draw_primitive  primitive,
+        buffer_handle   arguments_buffer,
+        size_t          arguments_offset,
+        size_t          draws_count,
+        size_t          arguments_stride
+    );
+
+    void multi_draw_indexed_indirect(
+        draw_primitive  primitive,
+        buffer_handle   arguments_buffer,
+        size_t          arguments_offset,
+        size_t          draws_count,
+        size_t          arguments_stride
+    );
+}
+
+//Dispatching
+//Writes of a dispatch are made visible to the commands following it, unless a memory barrier is recorded in between
+namespace pikango::cmd
+{
+    void dispatch(size_t groups_x, size_t groups_y, size_t groups_z);
+
+    //The offset is in bytes
+    void dispatch_indirect(buffer_handle arguments_buffer, size_t arguments_offset);
 }
 
 #endif
@@ -1,53 +1,103 @@
 #pragma once
 #include <atomic>
+#include <utility>
+#include <new>
+#include <cstdint>
 
 namespace pikango_internal
 {
+    struct handle_meta_block
+    {
+        std::atomic<uint64_t> refs;
+    };
+
+    //Handled object is allocated together with its meta block, in one memory block
+    template<class handled_object>
+    struct handle_block
+    {
+        handle_meta_block   meta;
+        handled_object      object;
+    };
+
+    //Provided by the implementation, allocates memory for a handle_block<T>
+    template<class T>
+    void* implementations_allocator();
+
+    //Provided by the implementation, destroys the object and frees the block it lives in
     template<class T>
-    void implementations_destructor(T*);
+    void implementations_destructor(T* object, handle_meta_block* block);
 
     template<class handled_object>
     class handle
     {
         template<class T> friend bool       is_empty(const handle<T>& handle);
         template<class T> friend size_t     handle_hash(const handle<T>& handle);
-        template<class T> friend handle<T>  make_handle (T* object);
+        template<class T> friend handle<T>  make_handle();
         template<class T> friend T*         obtain_handle_object(const handle<T>& handle);
+        template<class T> friend handle<T>  try_retain_handle(T* object, handle_meta_block* meta);
+        template<class T> friend void*      get_handle_meta_block_address(const handle<T>& handle);
         
     private:
-        struct meta_block;
+        using meta_block = handle_meta_block;
 
         handled_object* object;
         meta_block* meta;
 
-        handle(handled_object* _object) : object(_object)
-        {
-            meta = new meta_block;
-            meta->refs = 1;
-        }
+        handle(handled_object* _object, meta_block* _meta) : object(_object), meta(_meta) {};
+
+        void retain();
+        void release();
 
     public:
-        handle() : meta(nullptr), object(nullptr) {};
+        handle() : object(nullptr), meta(nullptr) {};
         handle(const handle& other);
+        handle(handle&& other) noexcept;
         ~handle();
         
-        void operator=(const handle& other);
+        handle& operator=(const handle& other);
+        handle& operator=(handle&& other) noexcept;
         bool operator==(const handle<handled_object>& other) const;
     };
 
+    //Taking a new reference only requires the counter to be atomic, it can be relaxed:
+    //the reference it is copied from keeps the object alive meanwhile
     template<class handled_object>
-    struct handle<handled_object>::meta_block
+    void handle<handled_object>::retain()
     {
-        std::atomic<uint64_t> refs;
-    };
+        if (meta != nullptr)
+            meta->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //Dropping a reference has to release the writes made through it,
+    //and the one destroying the object has to acquire all of them
+    template<class handled_object>
+    void handle<handled_object>::release()
+    {
+        if (meta != nullptr && meta->refs.fetch_sub(1, std::memory_order_release) == 1)
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            implementations_destructor(object, meta);
+        }
+
+        meta = nullptr;
+        object = nullptr;
+    }
 
     template<class handled_object>
     handle<handled_object>::handle(const handle& other): 
-        meta(other.meta), 
-        object(other.object)
+        object(other.object), 
+        meta(other.meta)
     {
-        if (meta != nullptr)
-            meta->refs++;
+        retain();
+    }
+
+    template<class handled_object>
+    handle<handled_object>::handle(handle&& other) noexcept: 
+        object(other.object), 
+        meta(other.meta)
+    {
+        other.object = nullptr;
+        other.meta = nullptr;
     }
     
     //this function exist only so the implementation could use meta addresses as hashes
@@ -66,30 +116,32 @@ namespace pikango_internal
     template<class handled_object>
     handle<handled_object>::~handle()
     {
-        if (meta != nullptr)
-        {
-            meta->refs--;
-            if (meta->refs == 0)
-            {
-                implementations_destructor(object);
-                delete meta;
-            }
-        }
-
-        meta = nullptr;
-        object = nullptr;
+        release();
     }
     
     template<class handled_object>
-    void handle<handled_object>::operator=(const handle& other)
+    handle<handled_object>& handle<handled_object>::operator=(const handle& other)
     {
-        this->~handle();
+        if (meta == other.meta) return *this;
+
+        //take the new reference first, other could be kept alive only by the released object
+        handle copy(other);
+        return *this = std::move(copy);
+    }
+
+    template<class handled_object>
+    handle<handled_object>& handle<handled_object>::operator=(handle&& other) noexcept
+    {
+        if (this == &other) return *this;
+
+        release();
 
         object = other.object;
         meta = other.meta;
 
-        if (meta != nullptr)
-            meta->refs++;
+        other.object = nullptr;
+        other.meta = nullptr;
+        return *this;
     }
 
     template <class handled_object>
@@ -112,10 +164,30 @@ namespace pikango_internal
         return (size_t)handle.meta;
     }
 
+    //Creates default constructed object with a single allocation, like std::make_shared
+    template<class handled_object>
+    handle<handled_object> make_handle()
+    {
+        void* memory = implementations_allocator<handled_object>();
+        auto block = new (memory) handle_block<handled_object>;
+
+        block->meta.refs.store(1, std::memory_order_relaxed);
+        return handle<handled_object>{&block->object, &block->meta};
+    }
+
+    //Takes a new reference only if the object is still alive
+    //lets the implementation keep registries of objects it does not own,
+    //the caller has to make sure the block is not freed meanwhile
     template<class handled_object>
-    handle<handled_object> make_handle(handled_object* object)
+    handle<handled_object> try_retain_handle(handled_object* object, handle_meta_block* meta)
     {
-        return handle<handled_object>{object};
+        uint64_t refs = meta->refs.load(std::memory_order_relaxed);
+
+        while (refs != 0)
+            if (meta->refs.compare_exchange_weak(refs, refs + 1, std::memory_order_relaxed))
+                return handle<handled_object>{object, meta};
+
+        return handle<handled_object>{};
     }
 
     template<class handled_object> 
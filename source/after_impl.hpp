@@ -1,16 +1,40 @@
-#define IMPLEMENT_DESTRUCTOR(name)  \
-    template<>                      \
-    void pikango_internal::implementations_destructor(name##_impl* impl) \
-    {                                                                    \
-        delete impl;                                                     \
-    }
-    
-IMPLEMENT_DESTRUCTOR(graphics_pipeline);
-//IMPLEMENT_DESTRUCTOR(compute_pipeline);
-IMPLEMENT_DESTRUCTOR(shader);
-IMPLEMENT_DESTRUCTOR(command_buffer);
-IMPLEMENT_DESTRUCTOR(fence);
-IMPLEMENT_DESTRUCTOR(buffer);
-IMPLEMENT_DESTRUCTOR(texture_sampler);
-IMPLEMENT_DESTRUCTOR(texture_buffer);
-IMPLEMENT_DESTRUCTOR(frame_buffer);
+#include "slab_pool.hpp"
+
+//Pools of blocks holding the object together with its meta block
+//they are shared by size class, handled types with the same block size and alignment use the same pool
+template<class T>
+using handle_blocks_pool = slab_pool<
+    sizeof(pikango_internal::handle_block<T>), 
+    alignof(pikango_internal::handle_block<T>)
+>;
+
+template<class T>
+void* pikango_internal::implementations_allocator()
+{
+    return handle_blocks_pool<T>::get().allocate();
+}
+
+template<class T>
+void pikango_internal::implementations_destructor(T* object, handle_meta_block* block)
+{
+    object->~T();
+    block->~handle_meta_block();
+    handle_blocks_pool<T>::get().release(block);
+}
+
+//Handles are copied and destroyed in the user code too, it has to link against these
+#define INSTANTIATE_HANDLE_ALLOCATION(name) \
+    template void* pikango_internal::implementations_allocator<pikango_internal::name##_impl>(); \
+    template void pikango_internal::implementations_destructor(pikango_internal::name##_impl*, handle_meta_block*);
+
+INSTANTIATE_HANDLE_ALLOCATION(graphics_pipeline);
+INSTANTIATE_HANDLE_ALLOCATION(compute_pipeline);
+INSTANTIATE_HANDLE_ALLOCATION(command_buffer);
+INSTANTIATE_HANDLE_ALLOCATION(fence);
+INSTANTIATE_HANDLE_ALLOCATION(shader);
+INSTANTIATE_HANDLE_ALLOCATION(buffer);
+INSTANTIATE_HANDLE_ALLOCATION(texture_sampler);
+INSTANTIATE_HANDLE_ALLOCATION(texture_buffer);
+INSTANTIATE_HANDLE_ALLOCATION(frame_buffer);
+
+#undef INSTANTIATE_HANDLE_ALLOCATION
@@ -1,50 +1,50 @@
 #pragma once
 
-namespace {
-    pikango::rasterization_pipeline_info  recent_rasterization_info;
-    pikango::depth_stencil_pipeline_info  recent_depth_stencil_info;
-};
-
-void apply_vertex_layout()
+//Vertex formats only change with the pipeline
+void apply_vertex_formats()
 {
-    for (int i = 0; i < 16; i++)
-        glDisableVertexAttribArray(i);
+    auto& layout = cmd_bindings::graphics_pipeline->vertex_layout;
+
+    for (auto& attrib : layout.attributes)
+    {
+        gl_set_vertex_attribute_format(attrib.location, attrib.format);
+        gl_vertex_attribute_binding(attrib.location, attrib.binding);
+    }
 
-    auto& vlc = cmd_bindings::graphics_pipeline->info.vertex_layout_info;
+    for (GLuint i = 0; i < gl_vertex_attributes_count; i++)
+        gl_set_vertex_attribute_enabled(i, layout.enabled_locations[i]);
+
+    for (GLuint i = 0; i < layout.bindings.size(); i++)
+        gl_vertex_binding_divisor(i, layout.bindings[i].divisor);
+}
+
+//Switching the buffers between draws only rebinds the binding points that changed
+void apply_vertex_buffers()
+{
+    auto& layout = cmd_bindings::graphics_pipeline->vertex_layout;
 
-    for (auto& attrib : vlc.attributes)
+    for (GLuint i = 0; i < layout.bindings.size(); i++)
     {
-        auto& buffer = cmd_bindings::vertex_buffers.at(attrib.binding);
-
-        glBindBuffer(
-            GL_ARRAY_BUFFER, 
-            buffer
-        );
-
-        glEnableVertexAttribArray(attrib.location);
-
-        glVertexAttribPointer(
-            attrib.location, 
-            get_elements_in_data_type(attrib.type), 
-            get_data_type(attrib.type), 
-            GL_FALSE, 
-            attrib.stride, 
-            (void*)(uintptr_t)(attrib.offset)
-        );
-
-        glVertexAttribDivisor(
-            attrib.location, 
-            attrib.per_instance ? 1 : 0
-        );
+        auto& binding = layout.bindings[i];
+
+        gl_bind_vertex_buffer(i, gl_vertex_buffer_binding{
+            (GLuint)cmd_bindings::vertex_buffers[binding.source_binding],
+            binding.offset,
+            binding.stride
+        });
     }
 }
 
 void apply_graphics_pipeline_shaders()
 {
+    auto gpi = cmd_bindings::graphics_pipeline;
+
     //Apply shaders
-    GLuint program_pipeline = get_program_pipeline(cmd_bindings::graphics_pipeline->info.shaders_info);
-    glUseProgram(0);
-    glBindProgramPipeline(program_pipeline);
+    if (gpi->program_pipeline == 0)
+        gpi->program_pipeline = get_program_pipeline(gpi->info.shaders_info);
+
+    gl_use_program(0);
+    gl_bind_program_pipeline(gpi->program_pipeline);
 }
 
 void apply_graphics_pipeline_settings()
@@ -53,63 +53,46 @@ void apply_graphics_pipeline_settings()
 
     //Apply rasterization settings  
     auto& rast = gpi->info.rasterization_info;
-    auto& r_rast = recent_rasterization_info;
-
-    if (rast.enable_culling != r_rast.enable_culling)
-    {
-        if (rast.enable_culling) glEnable(GL_CULL_FACE);
-        else                     glDisable(GL_CULL_FACE);  
-    }
 
-    if (rast.polygon_fill != r_rast.polygon_fill)
-        glPolygonMode(GL_FRONT_AND_BACK, get_rasterization_fill(rast.polygon_fill));
-
-    if (rast.culling_mode != r_rast.culling_mode)
-        glCullFace(get_culling_mode(rast.culling_mode));
-
-    if (rast.culling_front_face != r_rast.culling_front_face)
-        glFrontFace(get_front_face(rast.culling_front_face));
-
-    if (rast.line_width != r_rast.line_width)
-        glLineWidth(rast.line_width);
-
-    r_rast = rast;
+    gl_set_capability(gl_state.cull_face_enabled, GL_CULL_FACE, rast.enable_culling);
+    gl_polygon_mode(get_rasterization_fill(rast.polygon_fill));
+    gl_cull_face(get_culling_mode(rast.culling_mode));
+    gl_front_face(get_front_face(rast.culling_front_face));
+    gl_line_width(rast.line_width);
 
     //Apply depth stencil settings
     auto& ds = gpi->info.depth_stencil_info;
-    auto& r_ds = recent_depth_stencil_info;
-
-    if (ds.enable_depth_test != r_ds.enable_depth_test)
-    {
-        if (ds.enable_depth_test) glEnable(GL_DEPTH_TEST);
-        else                      glDisable(GL_DEPTH_TEST);  
-    }
 
-    if (ds.enable_depth_write != r_ds.enable_depth_write)
-    {
-        if (ds.enable_depth_write) glDepthMask(true);
-        else                       glDepthMask(false);  
-    }
-
-    r_ds = ds;
+    gl_set_capability(gl_state.depth_test_enabled, GL_DEPTH_TEST, ds.enable_depth_test);
+    gl_depth_mask(ds.enable_depth_write);
 }
 
 //we wait with actual binding until the draw because of openGl desing the bindings
 //could be overriden by other non-related stuff like writing to buffer
 static void apply_bindings()
 {
-    if (cmd_bindings::vertex_buffers_changed)
-        apply_vertex_layout();
+    if (cmd_bindings::graphics_pipeline_changed)
+        apply_vertex_formats();
+
+    //vertex buffers binding points are a part of the pipeline
+    if (cmd_bindings::vertex_buffers_changed || cmd_bindings::graphics_pipeline_changed)
+        apply_vertex_buffers();
     cmd_bindings::vertex_buffers_changed = false;
 
     if (cmd_bindings::index_buffer_changed)
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cmd_bindings::index_buffer);
+        gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, cmd_bindings::index_buffer);
     cmd_bindings::index_buffer_changed = false;
 
-    if (cmd_bindings::graphics_pipeline_changed) apply_graphics_pipeline_settings();
-    if (cmd_bindings::frame_buffer_changed)      glBindFramebuffer(GL_FRAMEBUFFER, cmd_bindings::frame_buffer);
+    if (cmd_bindings::graphics_pipeline_changed)
+        apply_graphics_pipeline_settings();
+
+    if (cmd_bindings::graphics_pipeline_changed || cmd_bindings::graphics_shaders_changed)
+        apply_graphics_pipeline_shaders();
+
+    cmd_bindings::graphics_pipeline_changed = false;
+    cmd_bindings::graphics_shaders_changed = false;
+
+    apply_compute_barrier();
 
-    //Always bind the program pipeline because it could have been
-    //overwritten by shaders functions
-    apply_graphics_pipeline_shaders();
+    gl_bind_frame_buffer(cmd_bindings::frame_buffer);
 }
@@ -9,39 +9,32 @@ struct pikango_internal::buffer_impl
 
 pikango::buffer_handle pikango::new_buffer(const buffer_create_info& info)
 {
-    auto bi = new pikango_internal::buffer_impl;
+    auto handle = pikango_internal::make_handle<pikango_internal::buffer_impl>();
+    auto bi = pikango_internal::obtain_handle_object(handle);
 
     bi->id = 0;
     bi->buffer_size    = info.buffer_size_bytes;
     bi->memory_profile = info.memory_profile;
     bi->access_profile = info.access_profile;
 
-    auto handle = pikango_internal::make_handle(bi);
-
     auto func = [](std::vector<std::any>& args)
     {
-        auto handle = std::any_cast<buffer_handle>(args[0]);
+        auto& handle = std::any_cast<buffer_handle&>(args[0]);
         auto bi = pikango_internal::obtain_handle_object(handle);
 
         glGenBuffers(1, &bi->id);
 
-        glBindBuffer(GL_COPY_WRITE_BUFFER, bi->id);
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, bi->id);
         glBufferData(GL_COPY_WRITE_BUFFER, bi->buffer_size, nullptr, get_buffer_usage_flag(bi->memory_profile, bi->access_profile));   
     };
     
-    enqueue_task(func, {handle}, pikango::queue_type::general);
+    enqueue_task(func, {handle}, pikango::queue_type::general, true);
     return handle;
 }
 
 pikango_internal::buffer_impl::~buffer_impl()
 {
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto id = std::any_cast<GLuint>(args[0]);
-        glDeleteBuffers(1, &id);
-    };
-
-    if (id != 0) enqueue_task(func, {id}, pikango::queue_type::general);
+    if (id != 0) retire_gl_name(&retired_gl_names::buffers, id);
 }
 
 size_t pikango::get_buffer_size(buffer_handle target)
@@ -52,30 +45,35 @@ size_t pikango::get_buffer_size(buffer_handle target)
 
 void pikango::cmd::bind_vertex_buffer(buffer_handle vertex_buffer, size_t binding)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto vertex_buffer = std::any_cast<buffer_handle>(args[0]);
-        auto binding       = std::any_cast<size_t>(args[1]);
+        pikango_internal::buffer_impl* bi;
+        size_t binding;
+    };
 
-        cmd_bindings::vertex_buffers.at(binding) = 
-            pikango_internal::obtain_handle_object(vertex_buffer)->id;
+    auto func = [](arguments& args)
+    {
+        cmd_bindings::vertex_buffers.at(args.binding) = args.bi->id;
         cmd_bindings::vertex_buffers_changed = true;
     };
 
-    record_task(func, {vertex_buffer, binding});
+    record_task("bind_vertex_buffer", func, arguments{retain_handle_object(vertex_buffer), binding});
 }
 
 void pikango::cmd::bind_index_buffer(buffer_handle index_buffer)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto index_buffer = std::any_cast<buffer_handle>(args[0]);
+        pikango_internal::buffer_impl* bi;
+    };
 
-        cmd_bindings::index_buffer = pikango_internal::obtain_handle_object(index_buffer)->id;
+    auto func = [](arguments& args)
+    {
+        cmd_bindings::index_buffer = args.bi->id;
         cmd_bindings::index_buffer_changed = true;
     };
 
-    record_task(func, {index_buffer});
+    record_task("bind_index_buffer", func, arguments{retain_handle_object(index_buffer)});
 }
 
 void pikango::cmd::bind_uniform_buffer(
@@ -85,60 +83,127 @@ void pikango::cmd::bind_uniform_buffer(
     size_t offset
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto uniform_buffer = std::any_cast<buffer_handle>(args[0]);
-        auto slot   = std::any_cast<size_t>(args[1]);
-        auto offset = std::any_cast<size_t>(args[2]);
-        auto size   = std::any_cast<size_t>(args[3]);
-
-        auto ubi = pikango_internal::obtain_handle_object(uniform_buffer);
-
-        glBindBufferRange(
-            GL_UNIFORM_BUFFER, 
-            slot, 
-            ubi->id, 
-            offset, 
-            size
+        pikango_internal::buffer_impl* ubi;
+        GLuint      slot;
+        GLintptr    offset;
+        GLsizeiptr  size;
+    };
+
+    auto func = [](arguments& args)
+    {
+        gl_bind_uniform_buffer_range(
+            args.slot, 
+            args.ubi->id, 
+            args.offset, 
+            args.size
         );
     };
 
-    record_task(func, {uniform_buffer, slot, offset, size});
+    record_task("bind_uniform_buffer", func, arguments{
+        retain_handle_object(uniform_buffer), 
+        (GLuint)slot, 
+        (GLintptr)offset, 
+        (GLsizeiptr)size
+    });
 }
 
-void pikango::cmd::write_buffer(buffer_handle target, size_t data_size_bytes, void* data)
+void pikango::cmd::bind_storage_buffer(buffer_handle storage_buffer, size_t slot, size_t size, size_t offset)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto handle = std::any_cast<buffer_handle>(args[0]);
-        auto size = std::any_cast<size_t>(args[1]);
-        auto data = std::any_cast<void*>(args[2]);
-
-        auto bi = pikango_internal::obtain_handle_object(handle);
+        pikango_internal::buffer_impl* sbi;
+        GLuint      slot;
+        GLintptr    offset;
+        GLsizeiptr  size;
+    };
 
-        glBindBuffer(GL_COPY_WRITE_BUFFER, bi->id);
-        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, data);
+    auto func = [](arguments& args)
+    {
+        gl_bind_storage_buffer_range(
+            args.slot, 
+            args.sbi->id, 
+            args.offset, 
+            args.size
+        );
     };
-    
-    record_task(func, {target, data_size_bytes, data});
+
+    record_task("bind_storage_buffer", func, arguments{
+        retain_handle_object(storage_buffer), 
+        (GLuint)slot, 
+        (GLintptr)offset, 
+        (GLsizeiptr)size
+    });
 }
 
-void pikango::cmd::write_buffer_region(buffer_handle target, size_t data_size_bytes, void* data, size_t data_offset_bytes)
+//The data is copied right away, small data into the command buffer, larger to the staging memory
+static void record_buffer_write(const char* name, const pikango::buffer_handle& target, size_t data_size_bytes, const void* data, size_t data_offset_bytes)
 {
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto handle = std::any_cast<buffer_handle>(args[0]);
-        auto size   = std::any_cast<size_t>(args[1]);
-        auto data   = std::any_cast<void*>(args[2]);
-        auto offset = std::any_cast<size_t>(args[3]);
+    auto cbi = pikango_internal::obtain_handle_object(recorded_command_buffer);
 
-        auto bi = pikango_internal::obtain_handle_object(handle);
+    if (data_size_bytes <= inline_payload_threshold)
+    {
+        struct arguments
+        {
+            pikango_internal::buffer_impl* bi;
+            const uint8_t*  data;
+            GLintptr        offset;
+            GLsizeiptr      size;
+        };
+
+        auto func = [](arguments& args)
+        {
+            apply_compute_barrier();
+
+            gl_bind_buffer(GL_COPY_WRITE_BUFFER, args.bi->id);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, args.offset, args.size, args.data);
+        };
+
+        record_task(name, func, arguments{
+            retain_handle_object(target),
+            cbi->stream.payloads.copy(data, data_size_bytes),
+            (GLintptr)data_offset_bytes,
+            (GLsizeiptr)data_size_bytes
+        });
+
+        return;
+    }
+
+    struct arguments
+    {
+        pikango_internal::buffer_impl* bi;
+        staging_block*  block;
+        size_t          staging_offset;
+        GLintptr        offset;
+        GLsizeiptr      size;
+    };
 
-        glBindBuffer(GL_COPY_WRITE_BUFFER, bi->id);
-        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    auto func = [](arguments& args)
+    {
+        apply_compute_barrier();
+        upload_from_staging(args.block, args.staging_offset, args.bi->id, args.offset, args.size);
     };
-    
-    record_task(func, {target, data_size_bytes, data, data_offset_bytes});
+
+    auto [block, staging_offset] = stage_upload(cbi->stream, data, data_size_bytes);
+
+    record_task(name, func, arguments{
+        retain_handle_object(target), 
+        block,
+        staging_offset,
+        (GLintptr)data_offset_bytes,
+        (GLsizeiptr)data_size_bytes
+    });
+}
+
+void pikango::cmd::write_buffer(buffer_handle target, size_t data_size_bytes, void* data)
+{
+    record_buffer_write("write_buffer", target, data_size_bytes, data, 0);
+}
+
+void pikango::cmd::write_buffer_region(buffer_handle target, size_t data_size_bytes, void* data, size_t data_offset_bytes)
+{
+    record_buffer_write("write_buffer_region", target, data_size_bytes, data, data_offset_bytes);
 }
 
 void pikango::cmd::copy_buffer_to_buffer(
@@ -149,22 +214,30 @@ void pikango::cmd::copy_buffer_to_buffer(
     size_t write_offset
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto source         = std::any_cast<buffer_handle>(args[0]);
-        auto destination    = std::any_cast<buffer_handle>(args[1]);
-        auto read_offset    = std::any_cast<size_t>(args[2]);
-        auto read_size      = std::any_cast<size_t>(args[3]);
-        auto write_offset   = std::any_cast<size_t>(args[4]);
+        pikango_internal::buffer_impl* sbi;
+        pikango_internal::buffer_impl* dbi;
+        GLintptr    read_offset;
+        GLsizeiptr  read_size;
+        GLintptr    write_offset;
+    };
 
-        auto sbi = pikango_internal::obtain_handle_object(source);
-        auto dbi = pikango_internal::obtain_handle_object(destination);
+    auto func = [](arguments& args)
+    {
+        apply_compute_barrier();
 
-        glBindBuffer(GL_COPY_READ_BUFFER, sbi->id);
-        glBindBuffer(GL_COPY_WRITE_BUFFER, dbi->id);
+        gl_bind_buffer(GL_COPY_READ_BUFFER, args.sbi->id);
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, args.dbi->id);
 
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, read_offset, write_offset, read_size);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, args.read_offset, args.write_offset, args.read_size);
     };
 
-    record_task(func, {source, destination, read_offset, read_size, write_offset});
+    record_task("copy_buffer_to_buffer", func, arguments{
+        retain_handle_object(source), 
+        retain_handle_object(destination), 
+        (GLintptr)read_offset, 
+        (GLsizeiptr)read_size, 
+        (GLintptr)write_offset
+    });
 }
@@ -1,12 +1,293 @@
+/*
+    Command Stream
+*/
+
+//Commands are recorded as fixed layout records, packed one after another in a single growable arena:
+//  [command_header][arguments][command_header][arguments]...
+//Arguments are trivially copyable structs, resources are referenced with raw impl pointers
+//and the handles keeping those resources alive are retained separately by the stream
+struct command_descriptor;
+
+using command_executor = void(*)(const command_descriptor* descriptor, void* arguments);
+
+//One static descriptor exists per recording function (there is one lambda per command)
+//so the record itself only has to store a pointer to it
+struct command_descriptor
+{
+    const char*         name;
+    size_t              record_size;
+    command_executor    executor;
+    void              (*function)();
+};
+
+struct command_header
+{
+    const command_descriptor* descriptor;
+};
+
+constexpr size_t command_record_alignment = alignof(command_header);
+
+constexpr size_t align_record_size(size_t size)
+{
+    return (size + command_record_alignment - 1) & ~(command_record_alignment - 1);
+}
+
+constexpr size_t command_arguments_offset = align_record_size(sizeof(command_header));
+
+template<class arguments_t>
+void execute_record(const command_descriptor* descriptor, void* arguments)
+{
+    auto function = reinterpret_cast<void(*)(arguments_t&)>(descriptor->function);
+    function(*static_cast<arguments_t*>(arguments));
+}
+
+template<class... handles_t>
+struct retained_handles
+{
+    std::tuple<std::vector<handles_t>...> lists;
+
+    template<class handled_object>
+    void retain(const pikango_internal::handle<handled_object>& handle)
+    {
+        using list_t = std::vector<pikango_internal::handle<handled_object>>;
+        auto& list = std::get<list_t>(lists);
+
+        //resources are usually bound over and over again, skip the repeated ones
+        if (list.size() != 0 && list.back() == handle) return;
+        list.push_back(handle);
+    }
+
+    void clear()
+    {
+        std::apply([](auto&... list) { (list.clear(), ...); }, lists);
+    }
+
+    //Leaves only one reference to each resource
+    void deduplicate()
+    {
+        auto deduplicate_list = [](auto& list)
+        {
+            auto less = [](auto& a, auto& b) { return pikango_internal::handle_hash(a) < pikango_internal::handle_hash(b); };
+            std::sort(list.begin(), list.end(), less);
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+            list.shrink_to_fit();
+        };
+
+        std::apply([&](auto&... list) { (deduplicate_list(list), ...); }, lists);
+    }
+
+    size_t size() const
+    {
+        return std::apply([](auto&... list) { return (list.size() + ... + 0); }, lists);
+    }
+};
+
+//Small data written with the commands is copied right into the command buffer
+//Chunks are never moved, so the commands can keep plain pointers to their data
+class payload_arena
+{
+public:
+    static constexpr size_t chunk_size = 64 * 1024;
+    static constexpr size_t alignment = 16;
+
+private:
+    std::vector<std::unique_ptr<uint8_t[]>> chunks;
+    size_t used_chunks = 0;
+    size_t chunk_offset = 0;
+    size_t used_bytes = 0;
+
+public:
+    //size has to fit a chunk
+    const uint8_t* copy(const void* data, size_t size)
+    {
+        chunk_offset = (chunk_offset + alignment - 1) & ~(alignment - 1);
+
+        if (used_chunks == 0 || chunk_offset + size > chunk_size)
+        {
+            if (used_chunks == chunks.size())
+                chunks.emplace_back(new uint8_t[chunk_size]);
+
+            used_chunks++;
+            chunk_offset = 0;
+        }
+
+        uint8_t* target = chunks[used_chunks - 1].get() + chunk_offset;
+        memcpy(target, data, size);
+
+        chunk_offset += size;
+        used_bytes += size;
+        return target;
+    }
+
+    //chunks are kept for the next recording
+    void clear()
+    {
+        used_chunks = 0;
+        chunk_offset = 0;
+        used_bytes = 0;
+    }
+
+    void compact()
+    {
+        chunks.resize(used_chunks);
+    }
+
+    size_t size() const { return used_bytes; }
+    size_t capacity() const { return chunks.size() * chunk_size; }
+};
+
+struct staging_block;
+static void retire_staging_blocks(std::vector<staging_block*>& blocks);
+
+struct command_stream
+{
+    std::vector<uint8_t> records;
+    size_t commands_count = 0;
+
+    retained_handles<
+        pikango::graphics_pipeline_handle,
+        pikango::compute_pipeline_handle,
+        pikango::buffer_handle,
+        pikango::texture_sampler_handle,
+        pikango::texture_buffer_handle,
+        pikango::frame_buffer_handle
+    > resources;
+
+    //written data up to inline_payload_threshold
+    payload_arena payloads;
+
+    //memory the larger written data was copied to, see upload_staging.hpp
+    std::vector<staging_block*> staging_blocks;
+    size_t staging_offset = 0;
+    size_t staging_bytes = 0;
+
+    //draws merged by coalesce_draws
+    size_t coalesced_draws = 0;
+
+    command_stream() = default;
+    command_stream(const command_stream&) = delete;
+    command_stream& operator=(const command_stream&) = delete;
+
+    ~command_stream()
+    {
+        retire_staging_blocks(staging_blocks);
+    }
+
+    template<class function_t, class arguments_t>
+    void record(const char* name, function_t function, const arguments_t& arguments)
+    {
+        static_assert(std::is_trivially_copyable_v<arguments_t>, "Command arguments must be trivially copyable");
+        static_assert(alignof(arguments_t) <= command_record_alignment, "Command arguments are overaligned");
+
+        constexpr size_t record_size = align_record_size(command_arguments_offset + sizeof(arguments_t));
+
+        static const command_descriptor descriptor = {
+            name,
+            record_size,
+            execute_record<arguments_t>,
+            reinterpret_cast<void(*)()>(static_cast<void(*)(arguments_t&)>(function))
+        };
+
+        size_t offset = records.size();
+        records.resize(offset + record_size);
+
+        auto header = command_header{&descriptor};
+        std::memcpy(&records[offset], &header, sizeof(header));
+        std::memcpy(&records[offset + command_arguments_offset], &arguments, sizeof(arguments));
+
+        commands_count++;
+    }
+
+    //Appends a record taken from another stream as it is
+    void copy_record(const uint8_t* record)
+    {
+        auto header = reinterpret_cast<const command_header*>(record);
+        records.insert(records.end(), record, record + header->descriptor->record_size);
+        commands_count++;
+    }
+
+    void execute()
+    {
+        size_t offset = 0;
+        while (offset < records.size())
+        {
+            auto header = reinterpret_cast<command_header*>(&records[offset]);
+            auto descriptor = header->descriptor;
+
+            descriptor->executor(descriptor, &records[offset + command_arguments_offset]);
+            offset += descriptor->record_size;
+        }
+    }
+
+    void clear()
+    {
+        records.clear();
+        commands_count = 0;
+        resources.clear();
+        payloads.clear();
+
+        retire_staging_blocks(staging_blocks);
+        staging_offset = 0;
+        staging_bytes = 0;
+
+        coalesced_draws = 0;
+    }
+
+    //Releases all the memory the stream does not use
+    void compact()
+    {
+        records.shrink_to_fit();
+        resources.deduplicate();
+        payloads.compact();
+    }
+};
+
+/*
+    Command Buffer
+*/
+
 struct pikango_internal::command_buffer_impl
 {
     pikango::queue_type target_queue_type;
-    std::vector<recorded_task> tasks;
+    pikango::command_buffer_usage usage;
+    bool coalesce_draws;
+    command_stream stream;
+
+    //submissions of this buffer that are waiting for or under execution
+    //the stream is executed in place, so it must not be rerecorded until they finish
+    std::atomic<size_t> pending_executions = 0;
 };
 
+namespace {
+    //all the command buffers share one condition, rerecording while submissions are pending is rare
+    std::atomic<size_t>         command_buffers_executed_waiters{0};
+    std::mutex                  command_buffers_executed_mutex;
+    std::condition_variable     command_buffers_executed_condition;
+};
+
+//Execution thread
+static void notify_command_buffers_executed()
+{
+    if (command_buffers_executed_waiters == 0) return;
+
+    { std::lock_guard<std::mutex> lock(command_buffers_executed_mutex); }
+    command_buffers_executed_condition.notify_all();
+}
+
+static bool is_execution_thread()
+{
+    auto id = std::this_thread::get_id();
+    return id == execution_thread_id || (transfer_thread_running && id == transfer_thread_id);
+}
+
 pikango::command_buffer_handle pikango::new_command_buffer(const command_buffer_create_info& info)
 {
-    auto handle = pikango_internal::make_handle(new pikango_internal::command_buffer_impl);
+    auto handle = pikango_internal::make_handle<pikango_internal::command_buffer_impl>();
+
+    auto cbi = pikango_internal::obtain_handle_object(handle);
+    cbi->usage = info.usage;
+    cbi->coalesce_draws = info.coalesce_draws;
+
     return handle;
 }
 
@@ -19,11 +300,85 @@ void pikango::configure_command_buffer(command_buffer_handle target, queue_type
 void pikango::begin_command_buffer_recording(command_buffer_handle target)
 {
     auto cbi = pikango_internal::obtain_handle_object(target);
-    cbi->tasks.clear();
+
+    //the stream is executed in place, so it waits for the submissions to finish executing
+    if (cbi->pending_executions != 0)
+    {
+        //the submissions could only execute after the current task
+        if (is_execution_thread())
+        {
+            log_error("Command buffer cannot be rerecorded on the execution thread while its submissions are pending");
+            return;
+        }
+
+        command_buffers_executed_waiters++;
+
+        {
+            std::unique_lock<std::mutex> lock(command_buffers_executed_mutex);
+            command_buffers_executed_condition.wait(lock, [&] { return cbi->pending_executions == 0; });
+        }
+
+        command_buffers_executed_waiters--;
+    }
+
+    cbi->stream.clear();
     recorded_command_buffer = target;
 }
 
+static void coalesce_draws(command_stream& stream);
+
 void pikango::end_command_buffer_recording(command_buffer_handle target)
 {
+    auto cbi = pikango_internal::obtain_handle_object(target);
+
+    if (cbi->coalesce_draws)
+        coalesce_draws(cbi->stream);
+
+    //Reusable buffers will keep their contents for long, while the one time buffers
+    //are rerecorded soon and keep the memory for the next recording
+    if (cbi->usage == command_buffer_usage::reusable)
+        cbi->stream.compact();
+
     recorded_command_buffer = {};
 }
+
+pikango::command_buffer_memory_report pikango::get_command_buffer_memory_report(command_buffer_handle target)
+{
+    auto cbi = pikango_internal::obtain_handle_object(target);
+    auto& stream = cbi->stream;
+
+    command_buffer_memory_report report;
+    report.commands_count       = stream.commands_count;
+    report.stream_bytes         = stream.records.size();
+    report.reserved_bytes       = stream.records.capacity();
+    report.retained_resources   = stream.resources.size();
+    report.staging_bytes        = stream.staging_bytes;
+    report.coalesced_draws      = stream.coalesced_draws;
+    report.payload_bytes        = stream.payloads.size();
+    report.reserved_bytes      += stream.payloads.capacity();
+
+    //Walk the stream and group records by their descriptors
+    std::unordered_map<const command_descriptor*, size_t> entries;
+
+    size_t offset = 0;
+    while (offset < stream.records.size())
+    {
+        auto header = reinterpret_cast<command_header*>(&stream.records[offset]);
+        auto descriptor = header->descriptor;
+
+        auto it = entries.find(descriptor);
+        if (it == entries.end())
+        {
+            it = entries.insert({descriptor, report.commands.size()}).first;
+            report.commands.push_back({descriptor->name, 0, 0});
+        }
+
+        auto& entry = report.commands[it->second];
+        entry.commands_count++;
+        entry.bytes += descriptor->record_size;
+
+        offset += descriptor->record_size;
+    }
+
+    return report;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+//Compute pipelines own their program pipeline, it only ever holds the one compute stage
+struct pikango_internal::compute_pipeline_impl
+{
+    pikango::compute_pipeline_create_info info;
+
+    //created on the first dispatch, execution thread only
+    GLuint program_pipeline = 0;
+
+    ~compute_pipeline_impl();
+};
+
+//Execution thread
+//Returns 0 if the pipeline has no usable shader, it is not cached then so a later dispatch can try again
+static GLuint get_compute_program_pipeline(pikango_internal::compute_pipeline_impl* cpi)
+{
+    if (cpi->program_pipeline != 0)
+        return cpi->program_pipeline;
+
+    if (pikango_internal::is_empty(cpi->info.compute_shader) || pikango_internal::obtain_handle_object(cpi->info.compute_shader)->id == 0)
+    {
+        log_error("Compute pipeline has no created compute shader");
+        return 0;
+    }
+
+    glGenProgramPipelines(1, &cpi->program_pipeline);
+    glUseProgramStages(cpi->program_pipeline, GL_COMPUTE_SHADER_BIT, pikango_internal::obtain_handle_object(cpi->info.compute_shader)->id);
+
+    return cpi->program_pipeline;
+}
+
+pikango_internal::compute_pipeline_impl::~compute_pipeline_impl()
+{
+    if (program_pipeline != 0)
+        retire_gl_name(&retired_gl_names::program_pipelines, program_pipeline);
+}
+
+pikango::compute_pipeline_handle pikango::new_compute_pipeline(const compute_pipeline_create_info& info)
+{
+    auto handle = pikango_internal::make_handle<pikango_internal::compute_pipeline_impl>();
+
+    auto impl   = pikango_internal::obtain_handle_object(handle);
+    impl->info  = info;
+
+    return handle;
+};
+
+void pikango::cmd::bind_compute_pipeline(compute_pipeline_handle pipeline)
+{
+    struct arguments
+    {
+        pikango_internal::compute_pipeline_impl* cpi;
+    };
+
+    auto func = [](arguments& args)
+    {
+        cmd_bindings::compute_pipeline = args.cpi;
+    };
+
+    record_task("bind_compute_pipeline", func, arguments{retain_handle_object(pipeline)});
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+//Dispatches use the program pipeline of the compute pipeline, so the next draw binds the graphics one again
+//Their writes are made visible with a full barrier issued lazily, before anything that could depend on them
+//unless a memory barrier with narrower scopes is recorded first
+//Returns false if the dispatch has to be skipped
+static bool apply_compute_bindings()
+{
+    if (cmd_bindings::compute_pipeline == nullptr)
+    {
+        log_error("Dispatch recorded without a compute pipeline bound");
+        return false;
+    }
+
+    GLuint program_pipeline = get_compute_program_pipeline(cmd_bindings::compute_pipeline);
+    if (program_pipeline == 0) return false;
+
+    apply_compute_barrier();
+
+    gl_use_program(0);
+    gl_bind_program_pipeline(program_pipeline);
+
+    cmd_bindings::graphics_shaders_changed = true;
+    return true;
+}
+
+void pikango::cmd::dispatch(size_t groups_x, size_t groups_y, size_t groups_z)
+{
+    struct arguments
+    {
+        GLuint groups_x;
+        GLuint groups_y;
+        GLuint groups_z;
+    };
+
+    auto func = [](arguments& args)
+    {
+        if (!apply_compute_bindings()) return;
+
+        glDispatchCompute(args.groups_x, args.groups_y, args.groups_z);
+        cmd_bindings::compute_writes_pending = true;
+    };
+
+    record_task("dispatch", func, arguments{
+        (GLuint)groups_x,
+        (GLuint)groups_y,
+        (GLuint)groups_z
+    });
+}
+
+void pikango::cmd::dispatch_indirect(buffer_handle arguments_buffer, size_t arguments_offset)
+{
+    struct arguments
+    {
+        pikango_internal::buffer_impl*  bi;
+        size_t                          offset;
+    };
+
+    auto func = [](arguments& args)
+    {
+        if (!apply_compute_bindings()) return;
+
+        gl_bind_buffer(GL_DISPATCH_INDIRECT_BUFFER, args.bi->id);
+        glDispatchComputeIndirect(args.offset);
+        cmd_bindings::compute_writes_pending = true;
+    };
+
+    record_task("dispatch_indirect", func, arguments{
+        retain_handle_object(arguments_buffer),
+        arguments_offset
+    });
+}
+
+void pikango::cmd::memory_barrier(memory_barrier_scope scopes)
+{
+    struct arguments
+    {
+        GLbitfield barriers;
+    };
+
+    auto func = [](arguments& args)
+    {
+        glMemoryBarrier(args.barriers);
+        cmd_bindings::compute_writes_pending = false;
+    };
+
+    record_task("memory_barrier", func, arguments{get_memory_barrier_bits(scopes)});
+}
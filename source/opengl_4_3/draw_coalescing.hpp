@@ -0,0 +1,129 @@
+#pragma once
+
+//Nothing can be bound between two consecutive draw_indexed commands, so a run of them only differs in the arguments
+//When the recording ends such runs are replaced with a single multi draw, reading the arguments
+//from the staging memory of the stream, which is a buffer the gpu can read directly
+
+namespace {
+    constexpr size_t min_coalesced_draws = 2;
+
+    struct coalesced_draws_arguments
+    {
+        GLenum          primitive;
+
+        staging_block*  block;
+        size_t          staging_offset;
+        GLsizei         draws_count;
+    };
+
+    auto execute_coalesced_draws = [](coalesced_draws_arguments& args)
+    {
+        apply_bindings();
+
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, args.block->buffer);
+        glMultiDrawElementsIndirect(args.primitive, GL_UNSIGNED_INT, (void*)args.staging_offset, args.draws_count, 0);
+    };
+};
+
+static const command_descriptor* get_record_descriptor(const std::vector<uint8_t>& records, size_t offset)
+{
+    return reinterpret_cast<const command_header*>(&records[offset])->descriptor;
+}
+
+static const draw_indexed_arguments* get_draw_indexed(const std::vector<uint8_t>& records, size_t offset)
+{
+    static const auto function = reinterpret_cast<void(*)()>(
+        static_cast<void(*)(draw_indexed_arguments&)>(execute_draw_indexed)
+    );
+
+    if (offset >= records.size() || get_record_descriptor(records, offset)->function != function)
+        return nullptr;
+
+    return reinterpret_cast<const draw_indexed_arguments*>(&records[offset + command_arguments_offset]);
+}
+
+//Returns the end of the run of draws with the same primitive starting at the offset
+static size_t find_draws_run_end(const std::vector<uint8_t>& records, size_t offset, size_t& draws_count)
+{
+    auto first = get_draw_indexed(records, offset);
+    draws_count = 0;
+
+    while (auto draw = get_draw_indexed(records, offset))
+    {
+        if (draw->primitive != first->primitive) break;
+
+        offset += get_record_descriptor(records, offset)->record_size;
+        draws_count++;
+    }
+
+    return offset;
+}
+
+static bool has_draws_run(const std::vector<uint8_t>& records)
+{
+    size_t offset = 0;
+    while (offset < records.size())
+    {
+        size_t draws_count = 0;
+        size_t run_end = find_draws_run_end(records, offset, draws_count);
+        if (draws_count >= min_coalesced_draws) return true;
+
+        offset = draws_count != 0 ? run_end : offset + get_record_descriptor(records, offset)->record_size;
+    }
+
+    return false;
+}
+
+static void coalesce_draws(command_stream& stream)
+{
+    if (!has_draws_run(stream.records)) return;
+
+    std::vector<uint8_t> records;
+    std::swap(records, stream.records);
+
+    stream.records.reserve(records.size());
+    stream.commands_count = 0;
+
+    std::vector<pikango::draw_indexed_indirect_arguments> draws;
+
+    size_t offset = 0;
+    while (offset < records.size())
+    {
+        size_t draws_count = 0;
+        size_t run_end = find_draws_run_end(records, offset, draws_count);
+
+        if (draws_count < min_coalesced_draws)
+        {
+            stream.copy_record(&records[offset]);
+            offset += get_record_descriptor(records, offset)->record_size;
+            continue;
+        }
+
+        draws.clear();
+        GLenum primitive = get_draw_indexed(records, offset)->primitive;
+
+        for (; offset < run_end; offset += get_record_descriptor(records, offset)->record_size)
+        {
+            auto draw = get_draw_indexed(records, offset);
+
+            draws.push_back({
+                (uint32_t)draw->indices_count,
+                (uint32_t)draw->instances_count,
+                (uint32_t)draw->indicies_buffer_offset,
+                draw->indicies_values_offset,
+                draw->instances_id_values_offset
+            });
+        }
+
+        auto [block, staging_offset] = stage_upload(stream, draws.data(), draws.size() * sizeof(draws[0]));
+
+        stream.record("coalesced_draws", execute_coalesced_draws, coalesced_draws_arguments{
+            primitive,
+            block,
+            staging_offset,
+            (GLsizei)draws.size()
+        });
+
+        stream.coalesced_draws += draws.size();
+    }
+}
@@ -14,36 +14,69 @@ void pikango::cmd::draw_vertices(
     size_t          instances_id_values_offset
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto primitive = std::any_cast<draw_primitive>(args[0]);
+        GLenum  primitive;
 
-        auto vertices_count = std::any_cast<size_t>(args[1]);
-        auto vertices_buffer_offset_index = std::any_cast<size_t>(args[2]);
+        GLsizei vertices_count;
+        GLint   vertices_buffer_offset_index;
 
-        auto instances_count = std::any_cast<size_t>(args[3]);
-        auto instances_id_values_offset = std::any_cast<size_t>(args[4]);
+        GLsizei instances_count;
+        GLuint  instances_id_values_offset;
+    };
 
+    auto func = [](arguments& args)
+    {
         apply_bindings();
 
         glDrawArraysInstancedBaseInstance(
-            get_primitive(primitive),
-            vertices_buffer_offset_index,
-            vertices_count,
-            instances_count,
-            instances_id_values_offset
+            args.primitive,
+            args.vertices_buffer_offset_index,
+            args.vertices_count,
+            args.instances_count,
+            args.instances_id_values_offset
         );
     };
 
-    record_task(func, {
-        primitive, 
-        vertices_count, 
-        vertices_buffer_offset_index,
-        instances_count,
-        instances_id_values_offset
+    record_task("draw_vertices", func, arguments{
+        get_primitive(primitive), 
+        (GLsizei)vertices_count, 
+        (GLint)vertices_buffer_offset_index,
+        (GLsizei)instances_count,
+        (GLuint)instances_id_values_offset
     });
 }
 
+//Named, so the draw coalescing can recognize the recorded draws
+struct draw_indexed_arguments
+{
+    GLenum  primitive;
+
+    GLsizei indices_count;
+    size_t  indicies_buffer_offset;
+    GLint   indicies_values_offset;
+
+    GLsizei instances_count;
+    GLuint  instances_id_values_offset;
+};
+
+namespace {
+    auto execute_draw_indexed = [](draw_indexed_arguments& args)
+    {
+        apply_bindings();
+
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            args.primitive,
+            args.indices_count,
+            GL_UNSIGNED_INT,
+            (void*)(args.indicies_buffer_offset * GL_UNSIGNED_INT_size_bytes),
+            args.instances_count,
+            args.indicies_values_offset,
+            args.instances_id_values_offset
+        );
+    };
+};
+
 void pikango::cmd::draw_indexed(
     draw_primitive  primitive,
 
@@ -55,36 +88,142 @@ void pikango::cmd::draw_indexed(
     size_t          instances_id_values_offset
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    record_task("draw_indexed", execute_draw_indexed, draw_indexed_arguments{
+        get_primitive(primitive), 
+        (GLsizei)indices_count, 
+        indicies_buffer_offset, 
+        indicies_values_offset,
+        (GLsizei)instances_count,
+        (GLuint)instances_id_values_offset
+    });
+}
+
+void pikango::cmd::draw_indirect(
+    draw_primitive  primitive,
+    buffer_handle   arguments_buffer,
+    size_t          arguments_offset
+)
+{
+    struct arguments
+    {
+        GLenum  primitive;
+
+        pikango_internal::buffer_impl*  bi;
+        size_t                          offset;
+    };
+
+    auto func = [](arguments& args)
+    {
+        apply_bindings();
+
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, args.bi->id);
+        glDrawArraysIndirect(args.primitive, (void*)args.offset);
+    };
+
+    record_task("draw_indirect", func, arguments{
+        get_primitive(primitive),
+        retain_handle_object(arguments_buffer),
+        arguments_offset
+    });
+}
+
+void pikango::cmd::draw_indexed_indirect(
+    draw_primitive  primitive,
+    buffer_handle   arguments_buffer,
+    size_t          arguments_offset
+)
+{
+    struct arguments
+    {
+        GLenum  primitive;
+
+        pikango_internal::buffer_impl*  bi;
+        size_t                          offset;
+    };
+
+    auto func = [](arguments& args)
+    {
+        apply_bindings();
+
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, args.bi->id);
+        glDrawElementsIndirect(args.primitive, GL_UNSIGNED_INT, (void*)args.offset);
+    };
+
+    record_task("draw_indexed_indirect", func, arguments{
+        get_primitive(primitive),
+        retain_handle_object(arguments_buffer),
+        arguments_offset
+    });
+}
+
+void pikango::cmd::multi_draw_indirect(
+    draw_primitive  primitive,
+    buffer_handle   arguments_buffer,
+    size_t          arguments_offset,
+    size_t          draws_count,
+    size_t          arguments_stride
+)
+{
+    struct arguments
     {
-        auto primitive = std::any_cast<draw_primitive>(args[0]);
+        GLenum  primitive;
 
-        auto indices_count = std::any_cast<size_t>(args[1]);
-        auto indicies_buffer_offset = std::any_cast<size_t>(args[2]);
-        auto indicies_values_offset = std::any_cast<int32_t>(args[3]);
+        pikango_internal::buffer_impl*  bi;
+        size_t                          offset;
 
-        auto instances_count = std::any_cast<size_t>(args[4]);
-        auto instances_id_values_offset = std::any_cast<size_t>(args[5]);
+        GLsizei draws_count;
+        GLsizei stride;
+    };
 
+    auto func = [](arguments& args)
+    {
         apply_bindings();
 
-        glDrawElementsInstancedBaseVertexBaseInstance(
-            get_primitive(primitive),
-            indices_count,
-            GL_UNSIGNED_INT,
-            (void*)(indicies_buffer_offset * GL_UNSIGNED_INT_size_bytes),
-            instances_count,
-            indicies_values_offset,
-            instances_id_values_offset
-        );
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, args.bi->id);
+        glMultiDrawArraysIndirect(args.primitive, (void*)args.offset, args.draws_count, args.stride);
     };
 
-    record_task(func, {
-        primitive, 
-        indices_count, 
-        indicies_buffer_offset, 
-        indicies_values_offset,
-        instances_count,
-        instances_id_values_offset
+    record_task("multi_draw_indirect", func, arguments{
+        get_primitive(primitive),
+        retain_handle_object(arguments_buffer),
+        arguments_offset,
+        (GLsizei)draws_count,
+        (GLsizei)arguments_stride
+    });
+}
+
+void pikango::cmd::multi_draw_indexed_indirect(
+    draw_primitive  primitive,
+    buffer_handle   arguments_buffer,
+    size_t          arguments_offset,
+    size_t          draws_count,
+    size_t          arguments_stride
+)
+{
+    struct arguments
+    {
+        GLenum  primitive;
+
+        pikango_internal::buffer_impl*  bi;
+        size_t                          offset;
+
+        GLsizei draws_count;
+        GLsizei stride;
+    };
+
+    auto func = [](arguments& args)
+    {
+        apply_bindings();
+
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, args.bi->id);
+        glMultiDrawElementsIndirect(args.primitive, GL_UNSIGNED_INT, (void*)args.offset, args.draws_count, args.stride);
+    };
+
+    record_task("multi_draw_indexed_indirect", func, arguments{
+        get_primitive(primitive),
+        retain_handle_object(arguments_buffer),
+        arguments_offset,
+        (GLsizei)draws_count,
+        (GLsizei)arguments_stride
     });
 }
@@ -2,73 +2,92 @@
 
 void pikango::cmd::set_viewport(const rectangle& rect)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto rect = std::any_cast<rectangle>(args[0]);
-        glViewport(rect.ax, rect.ay, rect.bx - rect.ax, rect.by - rect.ay);
+        rectangle rect;
     };
 
-    record_task(func, {rect});
+    auto func = [](arguments& args)
+    {
+        auto& rect = args.rect;
+        gl_viewport(rect.ax, rect.ay, rect.bx - rect.ax, rect.by - rect.ay);
+    };
+
+    record_task("set_viewport", func, arguments{rect});
 }
 
 void pikango::cmd::set_scissors(const rectangle& rect)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
+    {
+        rectangle rect;
+    };
+
+    auto func = [](arguments& args)
     {
-        auto rect = std::any_cast<rectangle>(args[0]);
-        glScissor(rect.ax, rect.ay, rect.bx - rect.ax, rect.by - rect.ay);
+        auto& rect = args.rect;
+        gl_scissor(rect.ax, rect.ay, rect.bx - rect.ax, rect.by - rect.ay);
     };
 
-    record_task(func, {rect});
+    record_task("set_scissors", func, arguments{rect});
 }
 
 void pikango::cmd::clear_render_space_color(float r, float g, float b, float a)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto r = std::any_cast<float>(args[0]);
-        auto g = std::any_cast<float>(args[1]);
-        auto b = std::any_cast<float>(args[2]);
-        auto a = std::any_cast<float>(args[3]);
+        float r;
+        float g;
+        float b;
+        float a;
+    };
 
-        if (cmd_bindings::frame_buffer_changed)      
-            glBindFramebuffer(GL_FRAMEBUFFER, cmd_bindings::frame_buffer);
+    auto func = [](arguments& args)
+    {
+        apply_compute_barrier();
+        gl_bind_frame_buffer(cmd_bindings::frame_buffer);
 
-        glClearColor(r, g, b, a); 
+        gl_clear_color(args.r, args.g, args.b, args.a);
         glClear(GL_COLOR_BUFFER_BIT);
     };
 
-    record_task(func, {r, g, b, a});
+    record_task("clear_render_space_color", func, arguments{r, g, b, a});
 }
 
 void pikango::cmd::clear_render_space_depth(float d)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto d = std::any_cast<float>(args[0]);
+        float d;
+    };
 
-        if (cmd_bindings::frame_buffer_changed)      
-            glBindFramebuffer(GL_FRAMEBUFFER, cmd_bindings::frame_buffer);
+    auto func = [](arguments& args)
+    {
+        apply_compute_barrier();
+        gl_bind_frame_buffer(cmd_bindings::frame_buffer);
 
-        glClearDepth(d);
+        gl_clear_depth(args.d);
         glClear(GL_DEPTH_BUFFER_BIT);
     };
 
-    record_task(func, {d});
+    record_task("clear_render_space_depth", func, arguments{d});
 }
 
 void pikango::cmd::clear_render_space_stencil(int s)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto s = std::any_cast<int>(args[0]);
+        int s;
+    };
 
-        if (cmd_bindings::frame_buffer_changed)      
-            glBindFramebuffer(GL_FRAMEBUFFER, cmd_bindings::frame_buffer);
+    auto func = [](arguments& args)
+    {
+        apply_compute_barrier();
+        gl_bind_frame_buffer(cmd_bindings::frame_buffer);
 
-        glClearStencil(s);
+        gl_clear_stencil(args.s);
         glClear(GL_STENCIL_BUFFER_BIT);
     };
 
-    record_task(func, {s});
+    record_task("clear_render_space_stencil", func, arguments{s});
 }
@@ -141,11 +141,50 @@ GLenum get_format_shader(pikango::shader_type type)
         case pikango::shader_type::vertex:   return GL_VERTEX_SHADER;
         case pikango::shader_type::pixel:    return GL_FRAGMENT_SHADER;
         case pikango::shader_type::geometry: return GL_GEOMETRY_SHADER;
+        case pikango::shader_type::compute:  return GL_COMPUTE_SHADER;
     }
     //will never happen
     return GL_VERTEX_SHADER;
 }
 
+GLenum get_image_access(pikango::image_access access)
+{
+    switch (access)
+    {
+        case pikango::image_access::read_only:  return GL_READ_ONLY;
+        case pikango::image_access::write_only: return GL_WRITE_ONLY;
+        case pikango::image_access::read_write: return GL_READ_WRITE;
+    }
+    //will never happen
+    return GL_READ_WRITE;
+}
+
+GLbitfield get_memory_barrier_bits(pikango::memory_barrier_scope scopes)
+{
+    if (scopes == pikango::memory_barrier_scope::all)
+        return GL_ALL_BARRIER_BITS;
+
+    constexpr std::pair<pikango::memory_barrier_scope, GLbitfield> bits[] = {
+        {pikango::memory_barrier_scope::vertex_attributes,  GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT},
+        {pikango::memory_barrier_scope::index_buffer,       GL_ELEMENT_ARRAY_BARRIER_BIT},
+        {pikango::memory_barrier_scope::uniform,            GL_UNIFORM_BARRIER_BIT},
+        {pikango::memory_barrier_scope::texture_fetch,      GL_TEXTURE_FETCH_BARRIER_BIT},
+        {pikango::memory_barrier_scope::image_access,       GL_SHADER_IMAGE_ACCESS_BARRIER_BIT},
+        {pikango::memory_barrier_scope::indirect_arguments, GL_COMMAND_BARRIER_BIT},
+        {pikango::memory_barrier_scope::pixel_buffer,       GL_PIXEL_BUFFER_BARRIER_BIT},
+        {pikango::memory_barrier_scope::texture_update,     GL_TEXTURE_UPDATE_BARRIER_BIT},
+        {pikango::memory_barrier_scope::buffer_update,      GL_BUFFER_UPDATE_BARRIER_BIT},
+        {pikango::memory_barrier_scope::frame_buffer,       GL_FRAMEBUFFER_BARRIER_BIT},
+        {pikango::memory_barrier_scope::storage_buffer,     GL_SHADER_STORAGE_BARRIER_BIT}
+    };
+
+    GLbitfield result = 0;
+    for (auto& [scope, bit] : bits)
+        if ((unsigned short)scopes & (unsigned short)scope) result |= bit;
+
+    return result;
+}
+
 GLenum get_texture_type(pikango::texture_type type) {
     switch (type)
     {
@@ -1,15 +1,24 @@
 //In opengl there is no such concept as queues
-//therefore we emulate this behavior by executing the general queue first 
-//and the other ones when the general queue is empty
-//therefore, since there are no actual queues, and there would be no gain in having multiple fake queues
+//therefore we emulate this behavior by sharing the execution thread between the queues
+//Each turn the thread executes a time slice of the queue that used the least time relative to its weight
+//so while several queues have work each gets a share of the thread proportional to its weight
+//A queue that was idle starts from the current virtual time instead of catching up on the time it missed
+//and a queue left waiting longer than the max wait is executed next regardless of its weight
+//since there are no actual queues, and there would be no gain in having multiple fake queues
 //pikango only allow for one compute and one tranfer queue in it's opengl implementation
+//The transfer queue only runs on its own once a shared context is given to the transfer thread
+//until then it is reported as unavailable, its submissions are still executed by the execution thread
+namespace {
+    std::atomic<bool> transfer_thread_running = false;
+};
+
 size_t pikango::get_queues_max_amount(pikango::queue_type type)
 {
     switch (type)
     {
     case pikango::queue_type::general: return 1;
     case pikango::queue_type::compute: return 1;
-    case pikango::queue_type::transfer: return 1;
+    case pikango::queue_type::transfer: return transfer_thread_running ? 1 : 0;
     }
 
     //Will never happen
@@ -29,83 +38,422 @@ void pikango::enable_queues(pikango::queue_type type, size_t amount)
     Execution
 */
 
+#include "mpsc_queue.hpp"
+
 namespace {
-    std::mutex                  execution_thread_sleep_mutex;
-    std::condition_variable     execution_thread_sleep_condition;
+    constexpr size_t execution_queue_capacity = 4096;
+    constexpr std::chrono::microseconds completions_poll_interval{100};
+
+    using scheduler_clock = std::chrono::steady_clock;
+
+    struct execution_queue
+    {
+        mpsc_queue<enqueued_task>   tasks{execution_queue_capacity};
+
+        //tasks that were pushed and not yet executed
+        std::atomic<size_t>         pending{0};
+
+        //tasks enqueued by the execution thread itself while the queue was full
+        //the execution thread cannot wait for itself to make space, so they are kept aside
+        std::vector<enqueued_task>  spilled;
+
+        //tasks taken from the queue and not executed yet, because the time slice ended
+        std::vector<enqueued_task>  taken;
+
+        //scheduling state, execution thread only
+        double                      weight = 1;
+        double                      virtual_time = 0;   //execution time divided by the weight
+        bool                        was_idle = true;
+        scheduler_clock::time_point waiting_since;      //since the queue has work and was not executed
+
+        //metrics, written by the thread executing the queue only
+        std::atomic<uint64_t>       executed_tasks{0};
+        std::atomic<uint64_t>       wait_microseconds{0};
+        std::atomic<uint64_t>       max_wait_microseconds{0};
+        std::atomic<uint64_t>       busy_microseconds{0};
+
+        //threads blocked in wait_queue_empty, the queue is only notified when it has some
+        std::atomic<size_t>         empty_waiters{0};
+        std::mutex                  empty_mutex;
+        std::condition_variable     empty_condition;
+    };
+
+    struct execution_thread_sleep
+    {
+        std::mutex                  mutex;
+        std::condition_variable     condition;
+
+        //producers only notify the thread once it has parked
+        std::atomic<bool>           parked = false;
+    };
+
+    execution_thread_sleep      general_thread_sleep;
+    execution_thread_sleep      transfer_thread_sleep;
+
+    pikango::execution_thread_wait_policy   execution_thread_wait_policy;
+    std::chrono::microseconds               execution_thread_spin_duration;
 
-    std::mutex                  general_queue_mutex;
-    std::queue<enqueued_task>   general_queue;
-    std::condition_variable     general_queue_empty_condition;
+    std::chrono::microseconds               queue_time_slice;
+    std::chrono::microseconds               queue_max_wait;
 
-    std::mutex                  compute_queue_mutex;
-    std::queue<enqueued_task>   compute_queue;
-    std::condition_variable     compute_queue_empty_condition;
+    //virtual time of the latest scheduled queue, queues that were idle start from it
+    double                                  scheduler_virtual_time = 0;
 
-    std::mutex                  transfer_queue_mutex;
-    std::queue<enqueued_task>   transfer_queue;
-    std::condition_variable     transfer_queue_empty_condition;
+    execution_queue             general_queue;
+    execution_queue             compute_queue;
+    execution_queue             transfer_queue;
 
-    bool should_execution_thread_terminate = false;
+    std::thread::id             execution_thread_id;
+    std::thread::id             transfer_thread_id;
 
+    std::atomic<bool> should_execution_thread_terminate = false;
+    std::atomic<bool> should_transfer_thread_terminate = false;
+
+    //creations of the objects that can be used by the work of the other queues
+    std::atomic<uint64_t>       objects_creations_enqueued{0};
+    std::atomic<uint64_t>       objects_creations_executed{0};     //written by the execution thread only
+
+    std::atomic<size_t>         all_tasks_done_waiters{0};
     std::mutex                  all_tasks_done_mutex;
     std::condition_variable     all_tasks_done_condition;
 };
 
+static execution_queue& get_execution_queue(pikango::queue_type type)
+{
+    switch (type)
+    {
+    case pikango::queue_type::general:  return general_queue;
+    case pikango::queue_type::compute:  return compute_queue;
+    case pikango::queue_type::transfer: return transfer_queue;
+    }
+
+    //Will never happen
+    return general_queue;
+}
+
 static bool all_queues_empty()
 {
-    return !(general_queue.size() + compute_queue.size() + transfer_queue.size());
+    return !(general_queue.pending + compute_queue.pending + transfer_queue.pending);
+}
+
+static bool is_transfer_queue_dedicated(const execution_queue& queue)
+{
+    return &queue == &transfer_queue && transfer_thread_running;
+}
+
+//Queues the execution thread takes the tasks from
+static bool execution_thread_queues_empty()
+{
+    size_t transfer_pending = transfer_thread_running ? 0 : transfer_queue.pending.load();
+    return !(general_queue.pending + compute_queue.pending + transfer_pending);
+}
+
+static void wake_thread(execution_thread_sleep& sleep)
+{
+    //The thread checks the queues after announcing it parks, and the producers
+    //announce tasks before checking whether it parked, so one of them always sees the other
+    if (!sleep.parked) return;
+
+    //Taking the mutex guarantees the thread is either waiting or yet to check its condition
+    { std::lock_guard<std::mutex> lock(sleep.mutex); }
+    sleep.condition.notify_one();
+}
+
+static void wake_execution_thread()
+{
+    wake_thread(general_thread_sleep);
+}
+
+static void wake_queue_thread(pikango::queue_type type)
+{
+    if (type == pikango::queue_type::transfer && transfer_thread_running)
+        wake_thread(transfer_thread_sleep);
+    else
+        wake_thread(general_thread_sleep);
+}
+
+static void push_to_execution_queue(execution_queue& queue, enqueued_task&& task)
+{
+    task.enqueued_at = scheduler_clock::now();
+    queue.pending++;
+
+    //the general queue executes in order, so its tasks always follow the creations enqueued before them
+    if (&queue != &general_queue)
+        task.required_creations = objects_creations_enqueued;
+
+    auto consumer_id = is_transfer_queue_dedicated(queue) ? transfer_thread_id : execution_thread_id;
+
+    while (!queue.tasks.try_push(task))
+    {
+        if (std::this_thread::get_id() == consumer_id)
+        {
+            queue.spilled.push_back(std::move(task));
+            return;
+        }
+
+        std::this_thread::yield();
+    }
+}
+
+static void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#endif
+}
+
+static bool execution_thread_has_work()
+{
+    return !execution_thread_queues_empty() || should_execution_thread_terminate;
+}
+
+static bool has_pending_completions();
+static void poll_pending_completions();
+static void await_transfer_thread();
+static void publish_objects_creations();
+static void delete_retired_gl_names();
+static void fence_retired_staging_blocks();
+struct staging_block;
+static void unmap_staging_blocks(std::vector<staging_block*>& blocks);
+
+//Spins or yields for the configured time, then parks on the sleep condition
+//While some fences or shaders are pending the thread only parks for a while, so it can poll them
+static void wait_for_tasks(
+    execution_thread_sleep& sleep,
+    bool(*has_work)(),
+    bool(*has_completions)(),
+    void(*poll_completions)()
+)
+{
+    auto spin_end = std::chrono::steady_clock::now() + execution_thread_spin_duration;
+
+    while (!has_work())
+    {
+        if (has_completions())
+            poll_completions();
+
+        bool should_park = 
+            execution_thread_wait_policy == pikango::execution_thread_wait_policy::park || 
+            std::chrono::steady_clock::now() >= spin_end;
+
+        if (should_park)
+        {
+            std::unique_lock<std::mutex> lock(sleep.mutex);
+            sleep.parked = true;
+
+            if (has_completions())
+                sleep.condition.wait_for(lock, completions_poll_interval, has_work);
+            else
+                sleep.condition.wait(lock, has_work);
+
+            sleep.parked = false;
+            continue;
+        }
+
+        if (execution_thread_wait_policy == pikango::execution_thread_wait_policy::yield_then_park)
+            std::this_thread::yield();
+        else
+            cpu_relax();
+    }
+}
+
+static void notify_queue_empty(execution_queue& queue)
+{
+    if (queue.empty_waiters == 0) return;
+
+    { std::lock_guard<std::mutex> lock(queue.empty_mutex); }
+    queue.empty_condition.notify_all();
+}
+
+static void notify_all_queues_empty()
+{
+    if (all_tasks_done_waiters == 0) return;
+
+    { std::lock_guard<std::mutex> lock(all_tasks_done_mutex); }
+    all_tasks_done_condition.notify_all();
+}
+
+static void execute_enqueued_task(enqueued_task& entry);
+
+static void add_queue_metric(std::atomic<uint64_t>& metric, uint64_t value)
+{
+    metric.store(metric.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+//Execution thread
+//Objects created right away instead of by a task, the batch creating them publishes them as well
+static void count_objects_creation()
+{
+    objects_creations_enqueued++;
+    objects_creations_executed++;
+}
+
+//Execution thread
+static bool are_task_objects_created(const enqueued_task& task)
+{
+    return task.required_creations <= objects_creations_executed;
+}
+
+//Execution thread
+//The queue waits for the general queue to create the objects its next task uses
+static bool is_waiting_for_objects_creations(const execution_queue& queue)
+{
+    return queue.taken.size() != 0 && !are_task_objects_created(queue.taken.front());
+}
+
+//Executes the task and measures how long it waited in the queue
+static void execute_queue_task(execution_queue& queue, enqueued_task& task, scheduler_clock::time_point now)
+{
+    auto wait = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - task.enqueued_at).count();
+
+    add_queue_metric(queue.executed_tasks, 1);
+    add_queue_metric(queue.wait_microseconds, wait);
+
+    if (wait > queue.max_wait_microseconds.load(std::memory_order_relaxed))
+        queue.max_wait_microseconds.store(wait, std::memory_order_relaxed);
+
+    execute_enqueued_task(task);
+}
+
+//Picks the queue that used the least time relative to its weight
+//unless some other queue has been waiting for longer than allowed
+static execution_queue* schedule_execution_queue()
+{
+    auto now = scheduler_clock::now();
+
+    execution_queue* chosen = nullptr;
+    execution_queue* starving = nullptr;
+
+    for (auto queue : {&general_queue, &compute_queue, &transfer_queue})
+    {
+        if (queue->pending == 0 || is_transfer_queue_dedicated(*queue))
+        {
+            queue->was_idle = true;
+            continue;
+        }
+
+        if (is_waiting_for_objects_creations(*queue))
+            continue;
+
+        //an idle queue does not save up time to monopolize the thread later
+        if (queue->was_idle)
+        {
+            queue->virtual_time = std::max(queue->virtual_time, scheduler_virtual_time);
+            queue->waiting_since = now;
+            queue->was_idle = false;
+        }
+
+        if (now - queue->waiting_since >= queue_max_wait)
+            if (starving == nullptr || queue->waiting_since < starving->waiting_since)
+                starving = queue;
+
+        if (chosen == nullptr || queue->virtual_time < chosen->virtual_time)
+            chosen = queue;
+    }
+
+    if (starving != nullptr)
+        chosen = starving;
+
+    if (chosen != nullptr)
+        scheduler_virtual_time = chosen->virtual_time;
+
+    return chosen;
+}
+
+//Executes the tasks of the queue until the time slice ends, returns how many were executed
+static size_t execute_queue_slice(execution_queue& queue)
+{
+    if (queue.taken.size() == 0)
+    {
+        queue.tasks.drain(queue.taken, execution_queue_capacity);
+
+        for (auto& task : queue.spilled)
+            queue.taken.push_back(std::move(task));
+        queue.spilled.clear();
+    }
+
+    auto slice_start = scheduler_clock::now();
+    auto slice_end = slice_start + queue_time_slice;
+    auto now = slice_start;
+
+    size_t executed = 0;
+    while (executed < queue.taken.size())
+    {
+        if (!are_task_objects_created(queue.taken[executed])) break;
+
+        execute_queue_task(queue, queue.taken[executed], now);
+        executed++;
+
+        now = scheduler_clock::now();
+        if (now >= slice_end) break;
+    }
+
+    queue.taken.erase(queue.taken.begin(), queue.taken.begin() + executed);
+
+    auto busy = std::chrono::duration_cast<std::chrono::microseconds>(now - slice_start).count();
+    add_queue_metric(queue.busy_microseconds, busy);
+
+    queue.virtual_time += busy / queue.weight;
+    queue.waiting_since = now;
+
+    return executed;
 }
 
 static void opengl_execution_thread_logic()
 {
+    execution_thread_id = std::this_thread::get_id();
+
     while (true)
     {
         //Wait for tasks
-        std::unique_lock<std::mutex> lock(execution_thread_sleep_mutex);
-        execution_thread_sleep_condition.wait(lock, []() { return !all_queues_empty() || should_execution_thread_terminate; });
+        wait_for_tasks(general_thread_sleep, execution_thread_has_work, has_pending_completions, poll_pending_completions);
 
         //If no tasks left and should terminate -> Leave
-        if (should_execution_thread_terminate && all_queues_empty() == 0) break;
+        if (should_execution_thread_terminate && execution_thread_queues_empty()) break;
 
-        //Take task
-        enqueued_task task;
+        //Work issued on the transfer thread has to be visible to the tasks
+        await_transfer_thread();
+
+        //the only work could have been left to the transfer thread that started in the meantime
+        execution_queue* source = schedule_execution_queue();
+        if (source == nullptr) continue;
+
+        //Execute the tasks
+        size_t executed = execute_queue_slice(*source);
+
+        //Objects created by the tasks are made visible to the transfer thread
+        publish_objects_creations();
+
+        //Releasing the tasks could have retired some objects as well
+        delete_retired_gl_names();
+        fence_retired_staging_blocks();
+
+        if (has_pending_completions())
+            poll_pending_completions();
+
+        //Notify about the tasks completion once the queues go idle
+        if ((source->pending -= executed) == 0)
+            notify_queue_empty(*source);
 
-        auto take_task_from_queue = [&](std::queue<enqueued_task>& queue, std::mutex& mutex, std::condition_variable& condition)
-        {
-            mutex.lock();
-            task = queue.front();
-            queue.pop();
-            mutex.unlock();
-
-            if (queue.size() == 0) 
-                condition.notify_one();
-        };
-        
-        if (general_queue.size() != 0)
-            take_task_from_queue(general_queue, general_queue_mutex, general_queue_empty_condition);
-
-        else if (compute_queue.size() != 0)
-            take_task_from_queue(compute_queue, compute_queue_mutex, compute_queue_empty_condition);
-
-        else if (transfer_queue.size() != 0)
-            take_task_from_queue(transfer_queue, transfer_queue_mutex, transfer_queue_empty_condition);
-        
-        //Unlock the sleep mutex
-        execution_thread_sleep_mutex.unlock();
-
-        //Execute the task
-        task.first(task.second);
-
-        //Notify about the tasks completion
         if (all_queues_empty())
-            all_tasks_done_condition.notify_all();
+            notify_all_queues_empty();
     }
 }
 
 static std::thread* opengl_execution_thread;
 
-static void start_opengl_execution_thread()
+static void start_opengl_execution_thread(const pikango::initialize_library_cpu_settings& settings)
 {
+    execution_thread_wait_policy    = settings.execution_thread_wait;
+    execution_thread_spin_duration  = std::chrono::microseconds(settings.execution_thread_spin_microseconds);
+
+    queue_time_slice    = std::chrono::microseconds(settings.queue_time_slice_microseconds);
+    queue_max_wait      = std::chrono::microseconds(settings.queue_max_wait_microseconds);
+
+    general_queue.weight    = std::max<double>(settings.general_queue_weight, 1);
+    compute_queue.weight    = std::max<double>(settings.compute_queue_weight, 1);
+    transfer_queue.weight   = std::max<double>(settings.transfer_queue_weight, 1);
+
     should_execution_thread_terminate = false;
     opengl_execution_thread = new std::thread{opengl_execution_thread_logic};
 }
@@ -114,7 +462,7 @@ static void stop_opengl_execution_thread()
 {
     //Notify the thread to stop
     should_execution_thread_terminate = true;
-    execution_thread_sleep_condition.notify_one();
+    wake_execution_thread();
 
     //Wait for the opengl thread
     opengl_execution_thread->join();
@@ -129,37 +477,41 @@ static void stop_opengl_execution_thread()
 
 void pikango::wait_queue_empty(queue_type type, size_t queue_index)
 {
-    std::queue<enqueued_task>*  queue;
-    std::mutex*                 mutex;
-    std::condition_variable*    condition;
+    auto& queue = get_execution_queue(type);
+
+    queue.empty_waiters++;
 
-    switch (type)
     {
-    case pikango::queue_type::general:
-        queue = &general_queue;
-        mutex = &general_queue_mutex;
-        condition = &general_queue_empty_condition;
-        break;
-    case pikango::queue_type::compute:
-        queue = &compute_queue;
-        mutex = &compute_queue_mutex;
-        condition = &compute_queue_empty_condition;
-        break;
-    case pikango::queue_type::transfer:
-        queue = &transfer_queue;
-        mutex = &transfer_queue_mutex;
-        condition = &transfer_queue_empty_condition;
-        break;
-    };
+        std::unique_lock lock(queue.empty_mutex);
+        queue.empty_condition.wait(lock, [&]{ return queue.pending == 0; });
+    }
 
-    std::unique_lock lock(*mutex);
-    condition->wait(lock, [&]{ return queue->size() == 0; });
+    queue.empty_waiters--;
+}
+
+pikango::queue_metrics pikango::get_queue_metrics(queue_type type, size_t queue_index)
+{
+    auto& queue = get_execution_queue(type);
+
+    queue_metrics metrics;
+    metrics.depth                   = queue.pending;
+    metrics.executed_tasks          = queue.executed_tasks;
+    metrics.wait_microseconds       = queue.wait_microseconds;
+    metrics.max_wait_microseconds   = queue.max_wait_microseconds.exchange(0);
+    metrics.busy_microseconds       = queue.busy_microseconds;
+    return metrics;
 }
 
 void pikango::wait_all_queues_empty()
 {
     if (all_queues_empty()) return;
-    
-    std::unique_lock lock(all_tasks_done_mutex);
-    all_tasks_done_condition.wait(lock, []{ return all_queues_empty(); });
+
+    all_tasks_done_waiters++;
+
+    {
+        std::unique_lock lock(all_tasks_done_mutex);
+        all_tasks_done_condition.wait(lock, []{ return all_queues_empty(); });
+    }
+
+    all_tasks_done_waiters--;
 }
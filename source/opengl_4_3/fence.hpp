@@ -1,13 +1,166 @@
+//Fences are signaled once the gpu has finished the submitted work, not when the calls were issued
+//The execution thread inserts a GLsync after the submission and polls it until it completes
+//Since the sync can only be queried on the context thread, other threads wait on the shared condition
 struct pikango_internal::fence_impl
 {
-    bool subbmitted = false;
-    bool is_signaled = false;
-    std::mutex mutex;
-    std::condition_variable condition;
+    //number of the latest submission with this fence and of the latest one that completed
+    std::atomic<uint64_t> submitted_value = 0;
+    std::atomic<uint64_t> signaled_value = 0;
+
+    //execution thread only
+    GLsync      sync = nullptr;
+    uint64_t    sync_value = 0;
+};
+
+namespace {
+    //all the fences share one condition instead of having own mutex and condition each
+    std::atomic<size_t>         fences_signal_waiters{0};
+    std::mutex                  fences_signal_mutex;
+    std::condition_variable     fences_signal_condition;
+
+    //fences with syncs yet to be signaled, each execution thread polls the ones it inserted
+    thread_local std::vector<pikango::fence_handle> pending_fences;
 };
 
 pikango::fence_handle pikango::new_fence(const fence_create_info& info)
 {
-    auto handle = pikango_internal::make_handle(new pikango_internal::fence_impl);
+    auto handle = pikango_internal::make_handle<pikango_internal::fence_impl>();
     return handle;
 }
+
+static bool is_fence_impl_signaled(pikango_internal::fence_impl* fi)
+{
+    return fi->signaled_value >= fi->submitted_value;
+}
+
+//Execution thread
+//Called after the submitted work was issued
+static void insert_fence(pikango::fence_handle& fence, uint64_t value)
+{
+    auto fi = pikango_internal::obtain_handle_object(fence);
+
+    //the fence was resubmitted before the previous sync completed
+    //the new sync completes later, so the old one is not needed anymore
+    if (fi->sync != nullptr)
+        glDeleteSync(fi->sync);
+    else
+        pending_fences.push_back(fence);
+
+    fi->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fi->sync_value = value;
+
+    //make sure the sync reaches the gpu, otherwise polling it could never succeed
+    glFlush();
+}
+
+static void signal_fence(pikango_internal::fence_impl* fi)
+{
+    glDeleteSync(fi->sync);
+    fi->sync = nullptr;
+    fi->signaled_value = fi->sync_value;
+}
+
+static void notify_fences_signaled()
+{
+    if (fences_signal_waiters == 0) return;
+
+    { std::lock_guard<std::mutex> lock(fences_signal_mutex); }
+    fences_signal_condition.notify_all();
+}
+
+//Execution thread
+static bool has_pending_fences()
+{
+    return pending_fences.size() != 0;
+}
+
+//Execution thread
+static void poll_pending_fences()
+{
+    bool any_signaled = false;
+
+    size_t i = 0;
+    while (i < pending_fences.size())
+    {
+        auto fi = pikango_internal::obtain_handle_object(pending_fences[i]);
+        GLenum status = glClientWaitSync(fi->sync, 0, 0);
+
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        {
+            signal_fence(fi);
+            any_signaled = true;
+
+            pending_fences[i] = std::move(pending_fences.back());
+            pending_fences.pop_back();
+        }
+        else
+            i++;
+    }
+
+    if (any_signaled)
+        notify_fences_signaled();
+}
+
+//Execution thread
+static void release_pending_fences()
+{
+    for (auto& fence : pending_fences)
+        signal_fence(pikango_internal::obtain_handle_object(fence));
+
+    pending_fences.clear();
+    notify_fences_signaled();
+}
+
+bool pikango::is_fence_signaled(fence_handle target)
+{
+    auto fi = pikango_internal::obtain_handle_object(target);
+    return is_fence_impl_signaled(fi);
+}
+
+void pikango::wait_fence(fence_handle target)
+{
+    auto fi = pikango_internal::obtain_handle_object(target);
+    if (is_fence_impl_signaled(fi)) return;
+
+    fences_signal_waiters++;
+
+    {
+        std::unique_lock<std::mutex> lock(fences_signal_mutex);
+        fences_signal_condition.wait(lock, [&] { return is_fence_impl_signaled(fi); });
+    }
+
+    fences_signal_waiters--;
+}
+
+bool pikango::wait_fence(fence_handle target, uint64_t timeout_nanoseconds)
+{
+    //timeouts this long would overflow the clock, treat them as no timeout
+    if (timeout_nanoseconds >= (uint64_t(1) << 62))
+    {
+        wait_fence(target);
+        return true;
+    }
+
+    auto fi = pikango_internal::obtain_handle_object(target);
+    if (is_fence_impl_signaled(fi)) return true;
+
+    fences_signal_waiters++;
+
+    bool signaled;
+    {
+        std::unique_lock<std::mutex> lock(fences_signal_mutex);
+        signaled = fences_signal_condition.wait_for(
+            lock,
+            std::chrono::nanoseconds(timeout_nanoseconds),
+            [&] { return is_fence_impl_signaled(fi); }
+        );
+    }
+
+    fences_signal_waiters--;
+    return signaled;
+}
+
+void pikango::wait_multiple_fences(std::vector<fence_handle> targets)
+{
+    for (auto& target : targets) wait_fence(target);
+}
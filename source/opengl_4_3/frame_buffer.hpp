@@ -6,11 +6,11 @@ struct pikango_internal::frame_buffer_impl
 
 pikango::frame_buffer_handle pikango::new_frame_buffer(const frame_buffer_create_info& info)
 {
-    auto handle = pikango_internal::make_handle(new pikango_internal::frame_buffer_impl);
+    auto handle = pikango_internal::make_handle<pikango_internal::frame_buffer_impl>();
 
     auto func = [](std::vector<std::any>& args)
     {
-        auto handle = std::any_cast<frame_buffer_handle>(args[0]);
+        auto& handle = std::any_cast<frame_buffer_handle&>(args[0]);
         auto fbi = pikango_internal::obtain_handle_object(handle);
         glGenFramebuffers(1, &fbi->id);
     };
@@ -21,14 +21,8 @@ pikango::frame_buffer_handle pikango::new_frame_buffer(const frame_buffer_create
 
 pikango_internal::frame_buffer_impl::~frame_buffer_impl()
 {
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto id = std::any_cast<GLuint>(args[0]);
-        glDeleteFramebuffers(1, &id);
-    };
-
     if (id != 0)
-        enqueue_task(func, {id}, pikango::queue_type::general);
+        retire_gl_name(&retired_gl_names::frame_buffers, id);
 }
 
 void pikango::attach_to_frame_buffer(
@@ -40,14 +34,14 @@ void pikango::attach_to_frame_buffer(
 {
     auto func = [](std::vector<std::any>& args)
     {
-        auto frame_buffer       = std::any_cast<frame_buffer_handle>(args[0]);
-        auto attachment         = std::any_cast<texture_buffer_handle>(args[1]);
+        auto& frame_buffer       = std::any_cast<frame_buffer_handle&>(args[0]);
+        auto& attachment         = std::any_cast<texture_buffer_handle&>(args[1]);
         auto attachment_type    = std::any_cast<size_t>(args[2]);
 
         auto fbi = pikango_internal::obtain_handle_object(frame_buffer);
         auto ai  = pikango_internal::obtain_handle_object(attachment);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, fbi->id);
+        gl_bind_frame_buffer(fbi->id);
         glFramebufferTexture2D(
             GL_FRAMEBUFFER, 
             attachment_type, 
@@ -69,7 +63,7 @@ struct init_default_frame_buffer
 {
     init_default_frame_buffer()
     {
-        default_frame_buffer = pikango_internal::make_handle(new pikango_internal::frame_buffer_impl);
+        default_frame_buffer = pikango_internal::make_handle<pikango_internal::frame_buffer_impl>();
         auto fbi = pikango_internal::obtain_handle_object(default_frame_buffer);
         fbi->id = 0;
     }   
@@ -82,13 +76,15 @@ pikango::frame_buffer_handle pikango::OPENGL_ONLY_get_default_frame_buffer()
 
 void pikango::cmd::bind_frame_buffer(frame_buffer_handle frame_buffer)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto frame_buffer = std::any_cast<frame_buffer_handle>(args[0]);
+        pikango_internal::frame_buffer_impl* fbi;
+    };
 
-        cmd_bindings::frame_buffer_changed = true;
-        cmd_bindings::frame_buffer = pikango_internal::obtain_handle_object(frame_buffer)->id;
+    auto func = [](arguments& args)
+    {
+        cmd_bindings::frame_buffer = args.fbi->id;
     };
     
-    record_task(func, {frame_buffer});
+    record_task("bind_frame_buffer", func, arguments{retain_handle_object(frame_buffer)});
 }
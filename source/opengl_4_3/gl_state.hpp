@@ -0,0 +1,468 @@
+#pragma once
+
+//Shadow copy of the context state, execution thread only
+//Every state change goes through it, so the calls that would not change anything are never issued
+//Unknown values always issue the call, the whole state is unknown after the context was handed to the user
+
+template<class T>
+struct gl_cached
+{
+    T       value{};
+    bool    known = false;
+};
+
+struct gl_buffer_range
+{
+    GLuint      id;
+    GLintptr    offset;
+    GLsizeiptr  size;
+
+    bool operator==(const gl_buffer_range& other) const
+    {
+        return id == other.id && offset == other.offset && size == other.size;
+    }
+};
+
+struct gl_image_binding
+{
+    GLuint      texture;
+    GLint       level;
+    GLboolean   layered;
+    GLenum      access;
+    GLenum      format;
+
+    bool operator==(const gl_image_binding& other) const
+    {
+        return 
+            texture == other.texture && level == other.level && layered == other.layered && 
+            access == other.access && format == other.format;
+    }
+};
+
+struct gl_vertex_attribute_format
+{
+    GLint       size;
+    GLenum      type;
+    GLuint      relative_offset;
+
+    bool operator==(const gl_vertex_attribute_format& other) const
+    {
+        return size == other.size && type == other.type && relative_offset == other.relative_offset;
+    }
+};
+
+struct gl_vertex_buffer_binding
+{
+    GLuint      buffer;
+    GLintptr    offset;
+    GLsizei     stride;
+
+    bool operator==(const gl_vertex_buffer_binding& other) const
+    {
+        return buffer == other.buffer && offset == other.offset && stride == other.stride;
+    }
+};
+
+//texture targets pikango binds, a unit keeps separate binding for each of them
+constexpr GLenum gl_texture_targets[] = {
+    GL_TEXTURE_1D,
+    GL_TEXTURE_1D_ARRAY,
+    GL_TEXTURE_2D,
+    GL_TEXTURE_2D_ARRAY,
+    GL_TEXTURE_3D,
+    GL_TEXTURE_CUBE_MAP
+};
+
+constexpr size_t gl_texture_targets_count = sizeof(gl_texture_targets) / sizeof(GLenum);
+
+//minimum guaranteed by gl 4.3 for both attributes and vertex buffer bindings
+constexpr size_t gl_vertex_attributes_count = 16;
+
+struct gl_texture_unit
+{
+    gl_cached<GLuint> textures[gl_texture_targets_count];
+    gl_cached<GLuint> sampler;
+};
+
+struct gl_context_state
+{
+    gl_cached<GLuint> element_array_buffer;
+    gl_cached<GLuint> copy_read_buffer;
+    gl_cached<GLuint> copy_write_buffer;
+    gl_cached<GLuint> pixel_unpack_buffer;
+    gl_cached<GLuint> draw_indirect_buffer;
+    gl_cached<GLuint> dispatch_indirect_buffer;
+    std::vector<gl_cached<gl_buffer_range>> uniform_buffers;
+    std::vector<gl_cached<gl_buffer_range>> storage_buffers;
+
+    gl_cached<GLuint> frame_buffer;
+    gl_cached<GLuint> program;
+    gl_cached<GLuint> program_pipeline;
+
+    gl_cached<GLuint> active_texture_unit;
+    std::vector<gl_texture_unit> texture_units;
+    std::vector<gl_cached<gl_image_binding>> image_units;
+
+    gl_cached<bool>                         vertex_attributes_enabled[gl_vertex_attributes_count];
+    gl_cached<gl_vertex_attribute_format>   vertex_attributes_formats[gl_vertex_attributes_count];
+    gl_cached<GLuint>                       vertex_attributes_bindings[gl_vertex_attributes_count];
+
+    gl_cached<gl_vertex_buffer_binding>     vertex_buffers[gl_vertex_attributes_count];
+    gl_cached<GLuint>                       vertex_buffers_divisors[gl_vertex_attributes_count];
+
+    gl_cached<std::array<GLint, 4>>     viewport;
+    gl_cached<std::array<GLint, 4>>     scissor;
+
+    gl_cached<bool>     cull_face_enabled;
+    gl_cached<bool>     depth_test_enabled;
+    gl_cached<bool>     scissor_test_enabled;
+    gl_cached<GLenum>   polygon_mode;
+    gl_cached<GLenum>   cull_face;
+    gl_cached<GLenum>   front_face;
+    gl_cached<float>    line_width;
+    gl_cached<bool>     depth_mask;
+
+    gl_cached<std::array<float, 4>>     clear_color;
+    gl_cached<double>                   clear_depth;
+    gl_cached<GLint>                    clear_stencil;
+};
+
+namespace {
+    //every execution thread has its own context
+    thread_local gl_context_state gl_state;
+
+    //written by the execution threads, read by anyone
+    std::atomic<uint64_t> gl_issued_calls{0};
+    std::atomic<uint64_t> gl_filtered_calls{0};
+};
+
+static void count_gl_call(std::atomic<uint64_t>& counter)
+{
+    //both execution threads count their calls
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+//Returns true if the call has to be issued
+template<class T>
+static bool update_gl_state(gl_cached<T>& cached, const T& value)
+{
+    if (cached.known && cached.value == value)
+    {
+        count_gl_call(gl_filtered_calls);
+        return false;
+    }
+
+    cached.value = value;
+    cached.known = true;
+
+    count_gl_call(gl_issued_calls);
+    return true;
+}
+
+//Forgets the whole state, nothing is assumed about the context afterwards
+static void invalidate_gl_state()
+{
+    gl_state = gl_context_state{};
+}
+
+template<class T>
+static T& gl_state_slot(std::vector<T>& slots, size_t index)
+{
+    if (index >= slots.size()) slots.resize(index + 1);
+    return slots[index];
+}
+
+static size_t get_gl_texture_target_index(GLenum target)
+{
+    for (size_t i = 0; i < gl_texture_targets_count; i++)
+        if (gl_texture_targets[i] == target) return i;
+
+    //Will never happen
+    return 0;
+}
+
+/*
+    Buffers
+*/
+
+static gl_cached<GLuint>& get_gl_buffer_binding(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ELEMENT_ARRAY_BUFFER:       return gl_state.element_array_buffer;
+    case GL_COPY_READ_BUFFER:           return gl_state.copy_read_buffer;
+    case GL_COPY_WRITE_BUFFER:          return gl_state.copy_write_buffer;
+    case GL_PIXEL_UNPACK_BUFFER:        return gl_state.pixel_unpack_buffer;
+    case GL_DRAW_INDIRECT_BUFFER:       return gl_state.draw_indirect_buffer;
+    case GL_DISPATCH_INDIRECT_BUFFER:   return gl_state.dispatch_indirect_buffer;
+    }
+
+    //Will never happen
+    return gl_state.copy_write_buffer;
+}
+
+static void gl_bind_buffer(GLenum target, GLuint id)
+{
+    if (update_gl_state(get_gl_buffer_binding(target), id))
+        glBindBuffer(target, id);
+}
+
+static void gl_bind_uniform_buffer_range(GLuint slot, GLuint id, GLintptr offset, GLsizeiptr size)
+{
+    auto& binding = gl_state_slot(gl_state.uniform_buffers, slot);
+
+    if (update_gl_state(binding, gl_buffer_range{id, offset, size}))
+        glBindBufferRange(GL_UNIFORM_BUFFER, slot, id, offset, size);
+}
+
+static void gl_bind_storage_buffer_range(GLuint slot, GLuint id, GLintptr offset, GLsizeiptr size)
+{
+    auto& binding = gl_state_slot(gl_state.storage_buffers, slot);
+
+    if (update_gl_state(binding, gl_buffer_range{id, offset, size}))
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, slot, id, offset, size);
+}
+
+/*
+    Objects
+*/
+
+static void gl_bind_frame_buffer(GLuint id)
+{
+    if (update_gl_state(gl_state.frame_buffer, id))
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+}
+
+static void gl_use_program(GLuint id)
+{
+    if (update_gl_state(gl_state.program, id))
+        glUseProgram(id);
+}
+
+static void gl_bind_program_pipeline(GLuint id)
+{
+    if (update_gl_state(gl_state.program_pipeline, id))
+        glBindProgramPipeline(id);
+}
+
+/*
+    Textures
+*/
+
+static void gl_active_texture(GLuint unit)
+{
+    if (update_gl_state(gl_state.active_texture_unit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+static void gl_bind_texture(GLuint unit, GLenum target, GLuint id)
+{
+    auto& texture_unit = gl_state_slot(gl_state.texture_units, unit);
+    auto& binding = texture_unit.textures[get_gl_texture_target_index(target)];
+
+    //activated even when the texture is already bound, the target based calls following the bind act on the active unit
+    gl_active_texture(unit);
+
+    if (update_gl_state(binding, id))
+        glBindTexture(target, id);
+}
+
+static void gl_bind_sampler(GLuint unit, GLuint id)
+{
+    auto& texture_unit = gl_state_slot(gl_state.texture_units, unit);
+
+    if (update_gl_state(texture_unit.sampler, id))
+        glBindSampler(unit, id);
+}
+
+static void gl_bind_image_texture(GLuint unit, const gl_image_binding& image)
+{
+    auto& binding = gl_state_slot(gl_state.image_units, unit);
+
+    if (update_gl_state(binding, image))
+        glBindImageTexture(unit, image.texture, image.level, image.layered, 0, image.access, image.format);
+}
+
+/*
+    Vertex Attributes
+*/
+
+static void gl_set_vertex_attribute_enabled(GLuint location, bool enabled)
+{
+    if (!update_gl_state(gl_state.vertex_attributes_enabled[location], enabled)) return;
+
+    if (enabled) glEnableVertexAttribArray(location);
+    else         glDisableVertexAttribArray(location);
+}
+
+static void gl_set_vertex_attribute_format(GLuint location, const gl_vertex_attribute_format& format)
+{
+    if (update_gl_state(gl_state.vertex_attributes_formats[location], format))
+        glVertexAttribFormat(location, format.size, format.type, GL_FALSE, format.relative_offset);
+}
+
+static void gl_vertex_attribute_binding(GLuint location, GLuint binding)
+{
+    if (update_gl_state(gl_state.vertex_attributes_bindings[location], binding))
+        glVertexAttribBinding(location, binding);
+}
+
+static void gl_bind_vertex_buffer(GLuint binding, const gl_vertex_buffer_binding& buffer)
+{
+    if (update_gl_state(gl_state.vertex_buffers[binding], buffer))
+        glBindVertexBuffer(binding, buffer.buffer, buffer.offset, buffer.stride);
+}
+
+static void gl_vertex_binding_divisor(GLuint binding, GLuint divisor)
+{
+    if (update_gl_state(gl_state.vertex_buffers_divisors[binding], divisor))
+        glVertexBindingDivisor(binding, divisor);
+}
+
+/*
+    Fixed Function
+*/
+
+static void gl_set_capability(gl_cached<bool>& cached, GLenum capability, bool enabled)
+{
+    if (!update_gl_state(cached, enabled)) return;
+
+    if (enabled) glEnable(capability);
+    else         glDisable(capability);
+}
+
+static void gl_viewport(GLint x, GLint y, GLint width, GLint height)
+{
+    if (update_gl_state(gl_state.viewport, std::array<GLint, 4>{x, y, width, height}))
+        glViewport(x, y, width, height);
+}
+
+static void gl_scissor(GLint x, GLint y, GLint width, GLint height)
+{
+    if (update_gl_state(gl_state.scissor, std::array<GLint, 4>{x, y, width, height}))
+        glScissor(x, y, width, height);
+}
+
+static void gl_polygon_mode(GLenum mode)
+{
+    if (update_gl_state(gl_state.polygon_mode, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+static void gl_cull_face(GLenum mode)
+{
+    if (update_gl_state(gl_state.cull_face, mode))
+        glCullFace(mode);
+}
+
+static void gl_front_face(GLenum mode)
+{
+    if (update_gl_state(gl_state.front_face, mode))
+        glFrontFace(mode);
+}
+
+static void gl_line_width(float width)
+{
+    if (update_gl_state(gl_state.line_width, width))
+        glLineWidth(width);
+}
+
+static void gl_depth_mask(bool enabled)
+{
+    if (update_gl_state(gl_state.depth_mask, enabled))
+        glDepthMask(enabled);
+}
+
+static void gl_clear_color(float r, float g, float b, float a)
+{
+    if (update_gl_state(gl_state.clear_color, std::array<float, 4>{r, g, b, a}))
+        glClearColor(r, g, b, a);
+}
+
+static void gl_clear_depth(double depth)
+{
+    if (update_gl_state(gl_state.clear_depth, depth))
+        glClearDepth(depth);
+}
+
+static void gl_clear_stencil(GLint stencil)
+{
+    if (update_gl_state(gl_state.clear_stencil, stencil))
+        glClearStencil(stencil);
+}
+
+/*
+    Deleted Names
+*/
+
+//Deleting an object unbinds it, and its name can be given to a new object right away
+//so the bindings of deleted names have to be forgotten, not just assumed to be zero
+template<class T, class predicate_t>
+static void forget_gl_state_if(gl_cached<T>& cached, predicate_t predicate)
+{
+    if (cached.known && predicate(cached.value)) cached.known = false;
+}
+
+static bool contains_gl_name(const std::vector<GLuint>& sorted_names, GLuint id)
+{
+    return std::binary_search(sorted_names.begin(), sorted_names.end(), id);
+}
+
+//Names lists are sorted in place
+static void forget_gl_state_names(retired_gl_names& names)
+{
+    auto sort = [](std::vector<GLuint>& list) { std::sort(list.begin(), list.end()); };
+    sort(names.buffers);
+    sort(names.textures);
+    sort(names.samplers);
+    sort(names.frame_buffers);
+    sort(names.programs);
+    sort(names.program_pipelines);
+
+    if (names.buffers.size() != 0)
+    {
+        auto deleted = [&](GLuint id) { return contains_gl_name(names.buffers, id); };
+
+        forget_gl_state_if(gl_state.element_array_buffer,       deleted);
+        forget_gl_state_if(gl_state.copy_read_buffer,           deleted);
+        forget_gl_state_if(gl_state.copy_write_buffer,          deleted);
+        forget_gl_state_if(gl_state.pixel_unpack_buffer,        deleted);
+        forget_gl_state_if(gl_state.draw_indirect_buffer,       deleted);
+        forget_gl_state_if(gl_state.dispatch_indirect_buffer,   deleted);
+
+        for (auto& binding : gl_state.uniform_buffers)
+            forget_gl_state_if(binding, [&](const gl_buffer_range& range) { return deleted(range.id); });
+
+        for (auto& binding : gl_state.storage_buffers)
+            forget_gl_state_if(binding, [&](const gl_buffer_range& range) { return deleted(range.id); });
+
+        for (auto& binding : gl_state.vertex_buffers)
+            forget_gl_state_if(binding, [&](const gl_vertex_buffer_binding& vb) { return deleted(vb.buffer); });
+    }
+
+    if (names.textures.size() != 0 || names.samplers.size() != 0)
+    {
+        for (auto& unit : gl_state.texture_units)
+        {
+            for (auto& binding : unit.textures)
+                forget_gl_state_if(binding, [&](GLuint id) { return contains_gl_name(names.textures, id); });
+
+            forget_gl_state_if(unit.sampler, [&](GLuint id) { return contains_gl_name(names.samplers, id); });
+        }
+
+        for (auto& binding : gl_state.image_units)
+            forget_gl_state_if(binding, [&](const gl_image_binding& image) { return contains_gl_name(names.textures, image.texture); });
+    }
+
+    forget_gl_state_if(gl_state.frame_buffer,       [&](GLuint id) { return contains_gl_name(names.frame_buffers, id); });
+    forget_gl_state_if(gl_state.program,            [&](GLuint id) { return contains_gl_name(names.programs, id); });
+    forget_gl_state_if(gl_state.program_pipeline,   [&](GLuint id) { return contains_gl_name(names.program_pipelines, id); });
+}
+
+pikango::OPENGL_ONLY_state_cache_report pikango::OPENGL_ONLY_get_state_cache_report()
+{
+    OPENGL_ONLY_state_cache_report report;
+    report.issued_calls     = gl_issued_calls.load(std::memory_order_relaxed);
+    report.filtered_calls   = gl_filtered_calls.load(std::memory_order_relaxed);
+    return report;
+}
@@ -1,26 +1,110 @@
+//Vertex layout translated to gl vertex formats and buffer binding points once, when the pipeline is created
+//Binding points are split by stride and divisor, pikango attributes sharing a binding can differ in both
+struct baked_vertex_attribute
+{
+    GLuint                      location;
+    GLuint                      binding;
+    gl_vertex_attribute_format  format;
+};
+
+struct baked_vertex_binding
+{
+    size_t      source_binding;     //pikango binding the vertex buffer is taken from
+    GLintptr    offset;             //part of the attribute offset exceeding the relative offset limit
+    GLsizei     stride;
+    GLuint      divisor;
+};
+
+struct baked_vertex_layout
+{
+    std::vector<baked_vertex_attribute> attributes;
+    std::vector<baked_vertex_binding>   bindings;
+    bool enabled_locations[gl_vertex_attributes_count] = {};
+};
+
 struct pikango_internal::graphics_pipeline_impl
 {
     pikango::graphics_pipeline_create_info info;
+    baked_vertex_layout vertex_layout;
+
+    //resolved on the first draw, execution thread only
+    //the pipeline keeps its shaders alive, so the program pipeline cannot be deleted meanwhile
+    GLuint program_pipeline = 0;
 };
 
+//minimum of GL_MAX_VERTEX_ATTRIB_RELATIVE_OFFSET guaranteed by gl 4.3
+constexpr size_t max_vertex_attribute_relative_offset = 2047;
+
+static baked_vertex_layout bake_vertex_layout(const pikango::vertex_layout_pipeline_info& info)
+{
+    baked_vertex_layout layout;
+
+    for (auto& attrib : info.attributes)
+    {
+        if (attrib.location >= gl_vertex_attributes_count || attrib.binding >= gl_vertex_attributes_count)
+        {
+            log_error("Vertex attribute location and binding have to be lower than 16");
+            continue;
+        }
+
+        baked_vertex_binding binding;
+        binding.source_binding  = attrib.binding;
+        binding.offset          = attrib.offset > max_vertex_attribute_relative_offset ? attrib.offset : 0;
+        binding.stride          = attrib.stride;
+        binding.divisor         = attrib.per_instance ? 1 : 0;
+
+        auto same_binding = [&](const baked_vertex_binding& other)
+        {
+            return 
+                other.source_binding == binding.source_binding && other.offset == binding.offset &&
+                other.stride == binding.stride && other.divisor == binding.divisor;
+        };
+
+        auto itr = std::find_if(layout.bindings.begin(), layout.bindings.end(), same_binding);
+        GLuint binding_index = itr - layout.bindings.begin();
+
+        if (itr == layout.bindings.end())
+            layout.bindings.push_back(binding);
+
+        baked_vertex_attribute baked;
+        baked.location  = attrib.location;
+        baked.binding   = binding_index;
+        baked.format    = gl_vertex_attribute_format{
+            (GLint)get_elements_in_data_type(attrib.type),
+            get_data_type(attrib.type),
+            (GLuint)(attrib.offset - binding.offset)
+        };
+
+        layout.attributes.push_back(baked);
+        layout.enabled_locations[attrib.location] = true;
+    }
+
+    return layout;
+}
+
 pikango::graphics_pipeline_handle pikango::new_graphics_pipeline(const graphics_pipeline_create_info& info)
 {
-    auto impl   = new pikango_internal::graphics_pipeline_impl;
+    auto handle = pikango_internal::make_handle<pikango_internal::graphics_pipeline_impl>();
+
+    auto impl   = pikango_internal::obtain_handle_object(handle);
     impl->info  = info;
+    impl->vertex_layout = bake_vertex_layout(info.vertex_layout_info);
 
-    auto handle = pikango_internal::make_handle(impl);
     return handle;
 };
 
 void pikango::cmd::bind_graphics_pipeline(graphics_pipeline_handle pipeline)
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto pipeline = std::any_cast<graphics_pipeline_handle>(args[0]);
+        pikango_internal::graphics_pipeline_impl* gpi;
+    };
 
+    auto func = [](arguments& args)
+    {
         cmd_bindings::graphics_pipeline_changed = true;
-        cmd_bindings::graphics_pipeline = pikango_internal::obtain_handle_object(pipeline);
+        cmd_bindings::graphics_pipeline = args.gpi;
     };
 
-    record_task(func, {pipeline});
+    record_task("bind_graphics_pipeline", func, arguments{retain_handle_object(pipeline)});
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+//Bounded lock-free multi-producer single-consumer ring queue
+//Every cell carries a sequence number telling whether it is ready to be written or read:
+//  sequence == position       -> cell is free for the producer claiming this position
+//  sequence == position + 1   -> cell holds a value for the consumer
+//Producers claim positions with a CAS on enqueue_position, the only consumer owns dequeue_position
+template<class T>
+class mpsc_queue
+{
+private:
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static constexpr size_t cache_line_size = 64;
+
+    std::unique_ptr<cell[]> cells;
+    size_t mask;
+
+    alignas(cache_line_size) std::atomic<size_t> enqueue_position;
+    alignas(cache_line_size) size_t dequeue_position;
+
+public:
+    //capacity has to be a power of two
+    mpsc_queue(size_t capacity) : cells(new cell[capacity]), mask(capacity - 1)
+    {
+        for (size_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+
+        enqueue_position.store(0, std::memory_order_relaxed);
+        dequeue_position = 0;
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    //Returns false if the queue is full, value is moved only on success
+    bool try_push(T& value)
+    {
+        size_t position = enqueue_position.load(std::memory_order_relaxed);
+        cell* target;
+
+        while (true)
+        {
+            target = &cells[position & mask];
+            size_t sequence = target->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+            if (difference == 0)
+            {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+
+        target->value = std::move(value);
+        target->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer only
+    bool try_pop(T& value)
+    {
+        cell* target = &cells[dequeue_position & mask];
+        size_t sequence = target->sequence.load(std::memory_order_acquire);
+
+        if ((intptr_t)sequence - (intptr_t)(dequeue_position + 1) < 0)
+            return false;
+
+        value = std::move(target->value);
+        target->value = T{};
+        target->sequence.store(dequeue_position + mask + 1, std::memory_order_release);
+        dequeue_position++;
+        return true;
+    }
+
+    //Consumer only, moves up to max_amount values to the end of the output
+    size_t drain(std::vector<T>& output, size_t max_amount)
+    {
+        size_t taken = 0;
+        T value;
+
+        while (taken < max_amount && try_pop(value))
+        {
+            output.push_back(std::move(value));
+            taken++;
+        }
+
+        return taken;
+    }
+};
@@ -1,63 +1,101 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
 
 #include <queue>
 #include <any>
+#include <tuple>
+#include <cstring>
+#include <algorithm>
 
 #include <sstream>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #include <immintrin.h>
+#endif
+
 #include "glad/glad.h"
 #include "enumerations.hpp"
 
 namespace
 {
     using opengl_task = void(*)(std::vector<std::any>&);
-    using recorded_task = std::pair<opengl_task, std::vector<std::any>>;
-    using enqueued_task = recorded_task;
     thread_local pikango::command_buffer_handle recorded_command_buffer;
+
+    pikango::error_notification_callback error_callback;
+
+    void log_error(const char* text)
+    {
+        if (error_callback != nullptr)
+            error_callback(text);
+        else
+            abort();
+    }
 }
 
+//Queue entry, either a single task or a submission of recorded command buffers
+//submissions keep a reference to the command buffers and execute their streams in place
+struct enqueued_task
+{
+    opengl_task             task = nullptr;
+    std::vector<std::any>   args;
+
+    pikango::command_buffer_handle                  command_buffer;
+    std::vector<pikango::command_buffer_handle>     command_buffers;    //executed in order, after command_buffer
+
+    pikango::fence_handle           fence;
+    uint64_t                        fence_value = 0;
+
+    //objects are created on the execution thread, the work of the other queues
+    //waits until the creations enqueued before it was submitted are executed
+    bool                            creates_objects = false;
+    uint64_t                        required_creations = 0;
+
+    std::chrono::steady_clock::time_point   enqueued_at;
+};
+
 #include "execution_thread.hpp"
 #include "command_buffer.hpp"
 #include "fence.hpp"
+#include "retired_objects.hpp"
 
 namespace
 {
-    void record_task(const opengl_task& task, std::vector<std::any>&& args)
+    template<class function_t, class arguments_t>
+    void record_task(const char* name, function_t function, const arguments_t& arguments)
     {
         auto cbi = pikango_internal::obtain_handle_object(recorded_command_buffer);
-        cbi->tasks.push_back({task, std::move(args)});
+        cbi->stream.record(name, function, arguments);
     }
 
-    void enqueue_task(const opengl_task& task, std::vector<std::any>&& args, pikango::queue_type target_queue_type)
+    //Keeps the resource alive for as long as the recorded command buffer holds its commands
+    //and returns the raw object that can be stored in the command arguments
+    template<class handled_object>
+    handled_object* retain_handle_object(const pikango_internal::handle<handled_object>& handle)
     {
-        auto push_task = [&](std::queue<enqueued_task>& queue, std::mutex& mutex, std::condition_variable& condition)
-        {
-            mutex.lock();
-            queue.push({task, std::move(args)});
-            mutex.unlock();
-        };
+        auto cbi = pikango_internal::obtain_handle_object(recorded_command_buffer);
+        cbi->stream.resources.retain(handle);
+        return pikango_internal::obtain_handle_object(handle);
+    }
 
-        switch (target_queue_type)
-        {
-        case pikango::queue_type::general:
-            push_task(general_queue, general_queue_mutex, general_queue_empty_condition);
-            break;
+    void enqueue_task(const opengl_task& task, std::vector<std::any>&& args, pikango::queue_type target_queue_type, bool creates_objects = false)
+    {
+        enqueued_task entry;
+        entry.task = task;
+        entry.args = std::move(args);
+        entry.creates_objects = creates_objects;
 
-        case pikango::queue_type::compute:
-            push_task(compute_queue, compute_queue_mutex, compute_queue_empty_condition);
-            break;
-            
-        case pikango::queue_type::transfer:
-            push_task(transfer_queue, transfer_queue_mutex, transfer_queue_empty_condition);
-            break;
-        }
+        if (creates_objects)
+            objects_creations_enqueued++;
 
-        execution_thread_sleep_condition.notify_one();
+        push_to_execution_queue(get_execution_queue(target_queue_type), std::move(entry));
+        wake_queue_thread(target_queue_type);
     }
 
-    void enqueue_task_and_wait(const opengl_task& task, std::vector<std::any>&& args, pikango::queue_type target_queue_type)
+    [[maybe_unused]] void enqueue_task_and_wait(const opengl_task& task, std::vector<std::any>&& args, pikango::queue_type target_queue_type, bool creates_objects = false)
     {
         std::mutex              mutex;
         std::condition_variable condition;
@@ -79,7 +117,7 @@ namespace
         args.push_back(&condition);
         args.push_back(&flag);
 
-        enqueue_task(wrapper, std::move(args), target_queue_type);
+        enqueue_task(wrapper, std::move(args), target_queue_type, creates_objects);
 
         std::unique_lock lock(mutex);
         condition.wait(lock, [&] { 
@@ -88,99 +126,86 @@ namespace
     }
 }
 
-void pikango::submit_command_buffer(pikango::command_buffer_handle cb, pikango::queue_type target_queue_type, size_t target_queue_index)
+static void execute_command_buffer(pikango::command_buffer_handle& cb)
 {
     auto cbi = pikango_internal::obtain_handle_object(cb);
-    
-    std::queue<enqueued_task>*  queue;
-    std::mutex*                 mutex;
+    unmap_staging_blocks(cbi->stream.staging_blocks);
+    cbi->stream.execute();
 
-    switch (target_queue_type)
-    {
-    case pikango::queue_type::general:
-        queue = &general_queue;
-        mutex = &general_queue_mutex;
-        break;
-    case pikango::queue_type::compute:
-        queue = &compute_queue;
-        mutex = &compute_queue_mutex;
-        break;
-    case pikango::queue_type::transfer:
-        queue = &transfer_queue;
-        mutex = &transfer_queue_mutex;
-        break;
-    };
+    if (--cbi->pending_executions == 0)
+        notify_command_buffers_executed();
+}
 
-    mutex->lock();
+static void execute_enqueued_task(enqueued_task& entry)
+{
+    if (entry.task != nullptr)
+        entry.task(entry.args);
 
-    for (auto& task : cbi->tasks)
-        queue->push(task);
+    if (entry.creates_objects)
+        objects_creations_executed++;
 
-    mutex->unlock();
+    if (!pikango_internal::is_empty(entry.command_buffer))
+        execute_command_buffer(entry.command_buffer);
 
-    execution_thread_sleep_condition.notify_one();
+    for (auto& cb : entry.command_buffers)
+        execute_command_buffer(cb);
+
+    if (!pikango_internal::is_empty(entry.fence))
+        insert_fence(entry.fence, entry.fence_value);
 }
 
-void pikango::submit_command_buffer_with_fence(pikango::command_buffer_handle cb, pikango::queue_type target_queue_type, size_t target_queue_index, fence_handle fence)
+static void mark_submitted(const pikango::command_buffer_handle& cb)
 {
     auto cbi = pikango_internal::obtain_handle_object(cb);
-    
-    std::queue<enqueued_task>*  queue;
-    std::mutex*                 mutex;
-
-    switch (target_queue_type)
-    {
-    case pikango::queue_type::general:
-        queue = &general_queue;
-        mutex = &general_queue_mutex;
-        break;
-    case pikango::queue_type::compute:
-        queue = &compute_queue;
-        mutex = &compute_queue_mutex;
-        break;
-    case pikango::queue_type::transfer:
-        queue = &transfer_queue;
-        mutex = &transfer_queue_mutex;
-        break;
-    };
+    cbi->pending_executions++;
+}
 
-    auto func = [](std::vector<std::any>& args)
+//The whole submission is a single queue entry, so it executes contiguously
+//even when other threads are submitting to the same queue at the same time
+static void enqueue_submission(enqueued_task& entry, pikango::queue_type target_queue_type, pikango::fence_handle& fence)
+{
+    if (!pikango_internal::is_empty(fence))
     {
-        auto fence = std::any_cast<fence_handle>(args[0]);
         auto fi = pikango_internal::obtain_handle_object(fence);
+        entry.fence_value = ++fi->submitted_value;
+        entry.fence = std::move(fence);
+    }
 
-        fi->is_signaled = true;
-        fi->condition.notify_one();
-    };
-
-    mutex->lock();
-
-    auto fi = pikango_internal::obtain_handle_object(fence);
-    fi->subbmitted = true;
-    fi->is_signaled = false;
+    push_to_execution_queue(get_execution_queue(target_queue_type), std::move(entry));
+    wake_queue_thread(target_queue_type);
+}
 
-    for (auto& task : cbi->tasks)
-        queue->push(task);
+void pikango::submit_command_buffer(pikango::command_buffer_handle cb, pikango::queue_type target_queue_type, size_t target_queue_index)
+{
+    fence_handle no_fence;
+    submit_command_buffer_with_fence(std::move(cb), target_queue_type, target_queue_index, no_fence);
+}
 
-    queue->push({func, {fence}});
+void pikango::submit_command_buffer_with_fence(pikango::command_buffer_handle cb, pikango::queue_type target_queue_type, size_t target_queue_index, fence_handle fence)
+{
+    mark_submitted(cb);
 
-    mutex->unlock();
+    enqueued_task entry;
+    entry.command_buffer = std::move(cb);
 
-    execution_thread_sleep_condition.notify_one();
+    enqueue_submission(entry, target_queue_type, fence);
 }
 
-void pikango::wait_fence(fence_handle target)
+void pikango::submit_command_buffers(const std::vector<command_buffer_handle>& targets, queue_type target_queue_type, size_t target_queue_index)
 {
-    auto fi = pikango_internal::obtain_handle_object(target);
-    if (fi->subbmitted == false) return;
-
-    std::unique_lock<std::mutex> lock(fi->mutex);
-    fi->condition.wait(lock, [&] { return fi->is_signaled || !fi->subbmitted; });
+    fence_handle no_fence;
+    submit_command_buffers_with_fence(targets, target_queue_type, target_queue_index, no_fence);
 }
 
-void pikango::wait_multiple_fences(std::vector<fence_handle> targets)
+void pikango::submit_command_buffers_with_fence(const std::vector<command_buffer_handle>& targets, queue_type target_queue_type, size_t target_queue_index, fence_handle fence)
 {
-    for (auto& target : targets) wait_fence(target);
+    for (auto& cb : targets)
+        mark_submitted(cb);
+
+    enqueued_task entry;
+    entry.command_buffers = targets;
+
+    enqueue_submission(entry, target_queue_type, fence);
 }
 
 /*
@@ -188,25 +213,67 @@ void pikango::wait_multiple_fences(std::vector<fence_handle> targets)
 */
 
 namespace {
-    GLuint VAO;
+    //vertex arrays are not shared between contexts, every execution thread has its own
+    thread_local GLuint VAO;
     GLint textures_pool_size;
     GLint textures_operation_unit;
+
+    //shaders compile in the driver threads, their status can be polled without blocking
+    bool parallel_shader_compile_supported = false;
 }
 
+#include "gl_state.hpp"
+#include "program_binary_cache.hpp"
+#include "upload_staging.hpp"
+
 /*
-    Library Implementation
+    Command Buffer Bindings
 */
 
-namespace {
-    pikango::error_notification_callback error_callback;
+//Kept per execution thread like the context state, the transfer thread executes commands too
+namespace cmd_bindings
+{
+    thread_local bool                   vertex_buffers_changed = false;
+    thread_local std::array<GLint, 16>  vertex_buffers;
 
-    void log_error(const char* text)
+    thread_local bool   index_buffer_changed = false;
+    thread_local GLint  index_buffer;
+
+    thread_local GLint  frame_buffer;
+
+    thread_local bool                                       graphics_pipeline_changed = false;
+    thread_local pikango_internal::graphics_pipeline_impl*  graphics_pipeline;
+
+    //dispatches bind their own program pipeline, the next draw applies the graphics shaders again
+    thread_local bool                                       graphics_shaders_changed = false;
+    thread_local pikango_internal::compute_pipeline_impl*   compute_pipeline = nullptr;
+
+    //dispatch writes are not visible to the following operations until a barrier
+    thread_local bool                                       compute_writes_pending = false;
+
+    //Makes the next draw apply all the bindings again
+    void invalidate()
     {
-        if (error_callback != nullptr)
-            error_callback(text);
-        else
-            abort();
+        vertex_buffers_changed = true;
+        index_buffer_changed = true;
+        graphics_pipeline_changed = graphics_pipeline != nullptr;
     }
+}
+
+//Called before anything that could read or overwrite what a dispatch wrote
+static void apply_compute_barrier()
+{
+    if (!cmd_bindings::compute_writes_pending) return;
+
+    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    cmd_bindings::compute_writes_pending = false;
+}
+
+/*
+    Library Implementation
+*/
+
+namespace {
 
     void GLAPIENTRY gl_log_error
     ( 
@@ -272,16 +339,32 @@ namespace {
     }
 }
 
+#include "transfer_thread.hpp"
+
 void pikango::OPENGL_ONLY_execute_on_context_thread(opengl_thread_task task, std::vector<std::any>&& args)
 {
-    enqueue_task(task, std::move(args), pikango::queue_type::general);
+    //The task could change any state, the cache cannot trust its values anymore
+    auto wrapper = [](std::vector<std::any>& args)
+    {
+        auto task = std::any_cast<opengl_thread_task>(args.back());
+        args.pop_back();
+
+        task(args);
+
+        invalidate_gl_state();
+        cmd_bindings::invalidate();
+    };
+
+    args.push_back(task);
+    enqueue_task(wrapper, std::move(args), pikango::queue_type::general);
 }
 
 std::string pikango::initialize_library_cpu(const initialize_library_cpu_settings& settings)
 {
     error_callback = settings.error_callback;
+    program_binary_cache_directory = settings.program_binary_cache_directory;
 
-    start_opengl_execution_thread();
+    start_opengl_execution_thread(settings);
     return "";
 }
 
@@ -289,6 +372,9 @@ std::string pikango::initialize_library_gpu()
 {
     auto func = [](std::vector<std::any>&)
     {
+        //the context could have been used before
+        invalidate_gl_state();
+
         //create VAO object
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
@@ -297,10 +383,42 @@ std::string pikango::initialize_library_gpu()
         glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &textures_pool_size);
         textures_pool_size--;   //Reserve last active texture for writing
         textures_operation_unit = textures_pool_size;
-        glActiveTexture(GL_TEXTURE0 + textures_operation_unit);
+        gl_active_texture(textures_operation_unit);
+
+        //check extensions
+        GLint extensions_count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_count);
+
+        for (GLint i = 0; i < extensions_count; i++)
+        {
+            auto extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+
+            if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+                strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+                parallel_shader_compile_supported = true;
+
+            if (strcmp(extension, "GL_ARB_buffer_storage") == 0)
+                buffer_storage_supported = true;
+        }
+
+        GLint major_version = 0, minor_version = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+        glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+
+        if (major_version > 4 || (major_version == 4 && minor_version >= 4))
+            buffer_storage_supported = true;
+
+    #ifndef PIKANGO_GL_BUFFER_STORAGE
+        //the loader was generated without the buffer storage functions
+        buffer_storage_supported = false;
+    #endif
+
+        initialize_upload_staging();
+
+        initialize_program_binary_cache();
 
         //enable scissors
-        glEnable(GL_SCISSOR_TEST);
+        gl_set_capability(gl_state.scissor_test_enabled, GL_SCISSOR_TEST, true);
 
         //enable error callback
         if (error_callback)
@@ -316,6 +434,7 @@ std::string pikango::initialize_library_gpu()
 }
 
 void delete_all_program_pipelines();
+static void release_compiling_shaders();
 
 std::string pikango::terminate()
 {
@@ -323,10 +442,20 @@ std::string pikango::terminate()
     {
         glDeleteVertexArrays(1, &VAO);
         delete_all_program_pipelines();
+        release_pending_fences();
+        release_compiling_shaders();
+        release_upload_staging();
+        release_transfer_sync();
+        delete_retired_gl_names();
     };
 
+    stop_opengl_transfer_thread();
+
     enqueue_task(func, {}, pikango::queue_type::general);
     stop_opengl_execution_thread();
+
+    //the binaries of the shaders compiled last are still written
+    stop_program_binary_writer();
     return "";
 }
 
@@ -336,25 +465,6 @@ const char* pikango::get_used_shading_language_name()
     return glsl;
 }
 
-/*
-    Command Buffer Bindings
-*/
-
-namespace cmd_bindings
-{
-    bool                    vertex_buffers_changed = false;
-    std::array<GLint, 16>   vertex_buffers;
-
-    bool    index_buffer_changed = false;
-    GLint   index_buffer;
-
-    bool    frame_buffer_changed = false;
-    GLint   frame_buffer;
-
-    bool                                        graphics_pipeline_changed = false;
-    pikango_internal::graphics_pipeline_impl*   graphics_pipeline;
-}
-
 /*
     Commands Implementations
 */
@@ -362,7 +472,25 @@ namespace cmd_bindings
 #include "graphics_pipeline.hpp"
 
 #include "shader.hpp"
+#include "shader_variant.hpp"
 #include "program.hpp"
+#include "compute_pipeline.hpp"
+
+//Execution thread
+static bool has_pending_completions()
+{
+    //blocks retired by the transfer thread are fenced even while the execution thread has no tasks
+    return has_pending_fences() || has_compiling_shaders() || has_fenced_staging_blocks() || any_staging_blocks_retired;
+}
+
+//Execution thread
+static void poll_pending_completions()
+{
+    if (has_pending_fences())           poll_pending_fences();
+    if (has_compiling_shaders())        poll_compiling_shaders();
+    if (any_staging_blocks_retired)     fence_retired_staging_blocks();
+    if (has_fenced_staging_blocks())    poll_fenced_staging_blocks();
+}
 
 #include "buffer.hpp"
 
@@ -375,22 +503,86 @@ void pikango::cmd::bind_texture(
     size_t slot        
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto texture_sampler = std::any_cast<texture_sampler_handle>(args[0]);
-        auto texture_buffer  = std::any_cast<texture_buffer_handle>(args[1]);
-        auto slot   = std::any_cast<size_t>(args[2]);
+        pikango_internal::texture_sampler_impl* tsi;
+        pikango_internal::texture_buffer_impl*  tbi;
+        GLuint slot;
+    };
 
-        auto tsi = pikango_internal::obtain_handle_object(texture_sampler);
-        auto tbi = pikango_internal::obtain_handle_object(texture_buffer);
+    auto func = [](arguments& args)
+    {
+        gl_bind_sampler(args.slot, args.tsi->id);
+        gl_bind_texture(args.slot, args.tbi->type, args.tbi->id);
+    };
 
-        glBindSampler(slot, tsi->id);
-        
-        glActiveTexture(GL_TEXTURE0 + slot);
-        glBindTexture(tbi->type, tbi->id);
+    record_task("bind_texture", func, arguments{
+        retain_handle_object(sampler), 
+        retain_handle_object(buffer), 
+        (GLuint)slot
+    });
+}
+
+//Only some of the formats can be used for image load and store
+static bool is_image_format_supported(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R8:
+    case GL_R16:
+    case GL_RG8:
+    case GL_RG16:
+    case GL_RGBA8:
+    case GL_RGBA16:
+    case GL_RGBA32F:
+        return true;
+    }
+
+    return false;
+}
+
+void pikango::cmd::bind_image(
+    texture_buffer_handle buffer,
+    size_t slot,
+    size_t mipmap_layer,
+    image_access access
+)
+{
+    struct arguments
+    {
+        pikango_internal::texture_buffer_impl*  tbi;
+        GLuint  slot;
+        GLint   mipmap_layer;
+        GLenum  access;
+    };
+
+    auto func = [](arguments& args)
+    {
+        auto tbi = args.tbi;
+
+        if (!is_image_format_supported(tbi->format))
+        {
+            log_error("Texture format cannot be bound as an image, only r8, r16, rg8, rg16, rgba8, rgba16 and rgba32f can");
+            return;
+        }
+
+        GLboolean layered = tbi->type != GL_TEXTURE_1D && tbi->type != GL_TEXTURE_2D;
+
+        gl_bind_image_texture(args.slot, gl_image_binding{
+            tbi->id,
+            args.mipmap_layer,
+            layered,
+            args.access,
+            tbi->format
+        });
     };
 
-    record_task(func, {sampler, buffer, slot});
+    record_task("bind_image", func, arguments{
+        retain_handle_object(buffer),
+        (GLuint)slot,
+        (GLint)mipmap_layer,
+        get_image_access(access)
+    });
 }
 
 #include "frame_buffer.hpp"
@@ -398,3 +590,5 @@ void pikango::cmd::bind_texture(
 #include "binding.hpp"
 #include "drawing_related.hpp"
 #include "drawing.hpp"
+#include "draw_coalescing.hpp"
+#include "dispatching.hpp"
@@ -12,12 +12,18 @@ namespace{
 
     struct graphics_shaders_pipeline_info_impl_ptr_identifier_hash
     {
+        //xor alone cancels out equal pointers and maps swapped stages to the same hash
+        static std::size_t combine(std::size_t seed, void* ptr)
+        {
+            return seed ^ (std::hash<void*>{}(ptr) + (std::size_t)0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+        }
+
         std::size_t operator()(const graphics_shaders_pipeline_info_impl_ptr_identifier& config) const
         {
             std::size_t seed = 0;
-            seed = seed ^ (size_t)config.vertex_shader_impl_ptr;
-            seed = seed ^ (size_t)config.pixel_shader_impl_ptr;
-            seed = seed ^ (size_t)config.geometry_shader_impl_ptr;
+            seed = combine(seed, config.vertex_shader_impl_ptr);
+            seed = combine(seed, config.pixel_shader_impl_ptr);
+            seed = combine(seed, config.geometry_shader_impl_ptr);
             return seed;
         }
     };
@@ -38,6 +44,7 @@ namespace{
 
 //program pipelines reigstry needs to be mutexed since it can be accessed 
 //by both exection thread when applying bindings and other threads in shaders deconstructors
+//it is only searched once per graphics pipeline, which then keeps the found id
 std::mutex program_pipelines_registry_mutex;
 std::unordered_map<
     graphics_shaders_pipeline_info_impl_ptr_identifier, 
@@ -96,6 +103,9 @@ void delete_dangling_program_pipelines(void* impl_ptr, pikango::shader_type type
     
     switch (type)
     {
+        //compute pipelines own their program pipelines, they are not in the registry
+        case pikango::shader_type::compute:
+            return;
         case pikango::shader_type::vertex:
             identifier_offset = offsetof(graphics_shaders_pipeline_info_impl_ptr_identifier, vertex_shader_impl_ptr);
             break;
@@ -134,14 +144,8 @@ void delete_dangling_program_pipelines(void* impl_ptr, pikango::shader_type type
 
     program_pipelines_registry_mutex.unlock();
 
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto ids = std::any_cast<std::vector<GLuint>>(args[0]);
-        glDeleteProgramPipelines(ids.size(), &ids[0]);
-    };
-
     if (pipelines_to_delete.size() != 0)
-        enqueue_task(func, {std::move(pipelines_to_delete)}, pikango::queue_type::general);
+        retire_gl_names(&retired_gl_names::program_pipelines, pipelines_to_delete);
 }
 
 void delete_all_program_pipelines()
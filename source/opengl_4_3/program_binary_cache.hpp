@@ -0,0 +1,204 @@
+#pragma once
+
+//Linked programs are stored in the cache directory with glGetProgramBinary and loaded back with glProgramBinary
+//Files are named after a hash of the source, the shader type and the driver, so updating the driver
+//makes the old binaries unused instead of rejected. Driver can reject a binary anyway, then the shader is compiled
+//The execution thread only retrieves the binaries, the files are written by a writer thread so it never waits for the disk
+#include <fstream>
+#include <cstdio>
+
+namespace {
+    std::string program_binary_cache_directory;
+
+    //renderer and version of the driver, set once the context is initialized
+    //empty when the cache is disabled or the driver does not support program binaries
+    std::string program_binary_cache_driver;
+
+    struct program_binary_file_header
+    {
+        char        magic[4];
+        uint32_t    format;
+    };
+
+    constexpr char program_binary_file_magic[4] = {'P', 'K', 'P', 'B'};
+
+    struct program_binary_write
+    {
+        std::string             path;
+        std::vector<uint8_t>    data;
+    };
+
+    std::thread*                        program_binary_writer = nullptr;
+    std::mutex                          program_binary_writes_mutex;
+    std::condition_variable             program_binary_writes_condition;
+    std::vector<program_binary_write>   program_binary_writes;
+    bool                                should_program_binary_writer_terminate = false;
+};
+
+static uint64_t fnv1a_hash(uint64_t hash, const void* data, size_t size)
+{
+    auto bytes = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool is_program_binary_cache_enabled()
+{
+    return program_binary_cache_driver.size() != 0;
+}
+
+//Writer thread
+static void write_program_binary_file(const program_binary_write& write)
+{
+    //other processes could be reading the cache, write aside and replace the file at once
+    auto temporary_path = write.path + ".tmp";
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write((const char*)write.data.data(), write.data.size());
+        if (!file) return;
+    }
+
+    std::rename(temporary_path.c_str(), write.path.c_str());
+}
+
+//Writes the queued binaries until terminated, the ones queued before are written first
+static void program_binary_writer_logic()
+{
+    std::vector<program_binary_write> writes;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(program_binary_writes_mutex);
+            program_binary_writes_condition.wait(lock, [] {
+                return program_binary_writes.size() != 0 || should_program_binary_writer_terminate;
+            });
+
+            if (program_binary_writes.size() == 0) break;
+            std::swap(writes, program_binary_writes);
+        }
+
+        for (auto& write : writes)
+            write_program_binary_file(write);
+        writes.clear();
+    }
+}
+
+static void stop_program_binary_writer()
+{
+    if (program_binary_writer == nullptr) return;
+
+    {
+        std::lock_guard<std::mutex> lock(program_binary_writes_mutex);
+        should_program_binary_writer_terminate = true;
+    }
+    program_binary_writes_condition.notify_one();
+
+    program_binary_writer->join();
+
+    delete program_binary_writer;
+    program_binary_writer = nullptr;
+}
+
+//Execution thread
+static void initialize_program_binary_cache()
+{
+    if (program_binary_cache_directory.size() == 0) return;
+
+    GLint formats_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats_count);
+    if (formats_count == 0) return;
+
+    program_binary_cache_driver  = (const char*)glGetString(GL_RENDERER);
+    program_binary_cache_driver += (const char*)glGetString(GL_VERSION);
+
+    should_program_binary_writer_terminate = false;
+    program_binary_writer = new std::thread{program_binary_writer_logic};
+}
+
+static uint64_t get_program_binary_key(const std::string& source, pikango::shader_type type)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = fnv1a_hash(hash, source.data(), source.size());
+    hash = fnv1a_hash(hash, program_binary_cache_driver.data(), program_binary_cache_driver.size());
+    hash = fnv1a_hash(hash, &type, sizeof(type));
+    return hash;
+}
+
+static std::string get_program_binary_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return program_binary_cache_directory + name;
+}
+
+//Returns an empty vector if the binary is not cached, the data starts with the header
+static std::vector<uint8_t> load_program_binary(uint64_t key)
+{
+    std::ifstream file(get_program_binary_path(key), std::ios::binary | std::ios::ate);
+    if (!file) return {};
+
+    auto size = (size_t)file.tellg();
+    if (size <= sizeof(program_binary_file_header)) return {};
+
+    std::vector<uint8_t> data(size);
+    file.seekg(0);
+    if (!file.read((char*)data.data(), size)) return {};
+
+    auto header = (const program_binary_file_header*)data.data();
+    if (memcmp(header->magic, program_binary_file_magic, sizeof(header->magic)) != 0) return {};
+
+    return data;
+}
+
+//Execution thread
+//Returns false if the driver rejected the binary
+static bool apply_program_binary(GLuint program, const std::vector<uint8_t>& data)
+{
+    program_binary_file_header header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    glProgramBinary(
+        program,
+        header.format,
+        data.data() + sizeof(header),
+        data.size() - sizeof(header)
+    );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+//Execution thread
+//Only retrieves the binary, the writer thread stores it
+static void save_program_binary(GLuint program, uint64_t key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length == 0) return;
+
+    std::vector<uint8_t> data(sizeof(program_binary_file_header) + length);
+
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, data.data() + sizeof(program_binary_file_header));
+
+    program_binary_file_header header;
+    memcpy(header.magic, program_binary_file_magic, sizeof(header.magic));
+    header.format = format;
+    memcpy(data.data(), &header, sizeof(header));
+
+    {
+        std::lock_guard<std::mutex> lock(program_binary_writes_mutex);
+        program_binary_writes.push_back(program_binary_write{get_program_binary_path(key), std::move(data)});
+    }
+    program_binary_writes_condition.notify_one();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+//GL objects are not deleted by the destructors of their owners, which can run on any thread
+//Their names are collected on retirement lists instead and deleted by the execution thread
+//with one batched glDelete* call per type, between batches of tasks, never in the middle of a command buffer
+struct retired_gl_names
+{
+    std::vector<GLuint> buffers;
+    std::vector<GLuint> textures;
+    std::vector<GLuint> samplers;
+    std::vector<GLuint> frame_buffers;
+    std::vector<GLuint> programs;
+    std::vector<GLuint> program_pipelines;
+};
+
+namespace {
+    std::mutex              retired_gl_names_mutex;
+    retired_gl_names        retired_names;
+    std::atomic<bool>       any_gl_names_retired = false;
+
+    //names taken from the retirement lists, execution thread only
+    retired_gl_names        deleted_names;
+};
+
+static void forget_gl_state_names(retired_gl_names& names);
+
+static void retire_gl_name(std::vector<GLuint> retired_gl_names::* list, GLuint id)
+{
+    std::lock_guard<std::mutex> lock(retired_gl_names_mutex);
+    (retired_names.*list).push_back(id);
+    any_gl_names_retired = true;
+}
+
+static void retire_gl_names(std::vector<GLuint> retired_gl_names::* list, const std::vector<GLuint>& ids)
+{
+    std::lock_guard<std::mutex> lock(retired_gl_names_mutex);
+    auto& target = retired_names.*list;
+    target.insert(target.end(), ids.begin(), ids.end());
+    any_gl_names_retired = true;
+}
+
+//Execution thread
+static void delete_retired_gl_names()
+{
+    if (!any_gl_names_retired) return;
+
+    {
+        std::lock_guard<std::mutex> lock(retired_gl_names_mutex);
+        std::swap(retired_names, deleted_names);
+        any_gl_names_retired = false;
+    }
+
+    auto& names = deleted_names;
+
+    if (names.buffers.size() != 0)
+        glDeleteBuffers(names.buffers.size(), names.buffers.data());
+
+    if (names.textures.size() != 0)
+        glDeleteTextures(names.textures.size(), names.textures.data());
+
+    if (names.samplers.size() != 0)
+        glDeleteSamplers(names.samplers.size(), names.samplers.data());
+
+    if (names.frame_buffers.size() != 0)
+        glDeleteFramebuffers(names.frame_buffers.size(), names.frame_buffers.data());
+
+    if (names.program_pipelines.size() != 0)
+        glDeleteProgramPipelines(names.program_pipelines.size(), names.program_pipelines.data());
+
+    //there is no batched variant for programs
+    for (auto id : names.programs)
+        glDeleteProgram(id);
+
+    forget_gl_state_names(names);
+
+    names.buffers.clear();
+    names.textures.clear();
+    names.samplers.clear();
+    names.frame_buffers.clear();
+    names.programs.clear();
+    names.program_pipelines.clear();
+}
@@ -3,69 +3,248 @@ struct pikango_internal::shader_impl
     GLuint id = 0;
     pikango::shader_type type;
 
+    std::atomic<pikango::shader_compile_status> status = pikango::shader_compile_status::compiling;
+
+    //shader object being compiled into the program, execution thread only
+    GLuint compiled_shader = 0;
+
+    //key of the program binary in the cache, zero if the cache is not used
+    uint64_t binary_cache_key = 0;
+
+    //shaders created with new_shader_variant are registered under the hash of their source
+    bool        is_variant = false;
+    uint64_t    variant_key = 0;
+
     ~shader_impl();
 };
 
+#ifndef GL_COMPLETION_STATUS_KHR
+    #define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+    //shaders whose compilation was started and not yet checked, execution thread only
+    std::vector<pikango::shader_handle> compiling_shaders;
+
+    std::atomic<size_t>         shaders_ready_waiters{0};
+    std::mutex                  shaders_ready_mutex;
+    std::condition_variable     shaders_ready_condition;
+};
+
+static std::string get_shader_info_log(GLuint shader)
+{
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+
+    std::string log(length, '\0');
+    if (length != 0) glGetShaderInfoLog(shader, length, nullptr, log.data());
+    return log;
+}
+
+static std::string get_program_info_log(GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+
+    std::string log(length, '\0');
+    if (length != 0) glGetProgramInfoLog(program, length, nullptr, log.data());
+    return log;
+}
+
+//Execution thread
+//With parallel compile the driver works on the shader in the background
+//and querying anything but the completion status would wait for it
+static bool is_shader_compilation_complete(pikango_internal::shader_impl* si)
+{
+    if (!parallel_shader_compile_supported) return true;
+
+    GLint completed = GL_FALSE;
+    glGetProgramiv(si->id, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+//Execution thread
+static void finish_shader_compilation(pikango_internal::shader_impl* si)
+{
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(si->compiled_shader, GL_COMPILE_STATUS, &compiled);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(si->id, GL_LINK_STATUS, &linked);
+
+    if (!compiled)
+        log_error(get_shader_info_log(si->compiled_shader).c_str());
+    else if (!linked)
+        log_error(get_program_info_log(si->id).c_str());
+
+    //Delete Shader
+    glDetachShader(si->id, si->compiled_shader);
+    glDeleteShader(si->compiled_shader);
+    si->compiled_shader = 0;
+
+    if (compiled && linked && si->binary_cache_key != 0)
+        save_program_binary(si->id, si->binary_cache_key);
+
+    si->status = (compiled && linked) ? pikango::shader_compile_status::ready : pikango::shader_compile_status::failed;
+}
+
+static void notify_shaders_ready()
+{
+    if (shaders_ready_waiters == 0) return;
+
+    { std::lock_guard<std::mutex> lock(shaders_ready_mutex); }
+    shaders_ready_condition.notify_all();
+}
+
+//Execution thread
+static bool has_compiling_shaders()
+{
+    return compiling_shaders.size() != 0;
+}
+
+//Execution thread
+static void poll_compiling_shaders()
+{
+    bool any_finished = false;
+
+    size_t i = 0;
+    while (i < compiling_shaders.size())
+    {
+        auto si = pikango_internal::obtain_handle_object(compiling_shaders[i]);
+
+        if (is_shader_compilation_complete(si))
+        {
+            finish_shader_compilation(si);
+            any_finished = true;
+
+            compiling_shaders[i] = std::move(compiling_shaders.back());
+            compiling_shaders.pop_back();
+        }
+        else
+            i++;
+    }
+
+    if (any_finished)
+        notify_shaders_ready();
+}
+
+//Execution thread
+static void release_compiling_shaders()
+{
+    for (auto& shader : compiling_shaders)
+        finish_shader_compilation(pikango_internal::obtain_handle_object(shader));
+
+    compiling_shaders.clear();
+    notify_shaders_ready();
+}
+
 pikango::shader_handle pikango::new_shader(const shader_create_info& info)
 {
-    auto si = new pikango_internal::shader_impl;
-    si->type = info.type;
+    auto handle = pikango_internal::make_handle<pikango_internal::shader_impl>();
 
-    auto handle = pikango_internal::make_handle(si);
+    auto si = pikango_internal::obtain_handle_object(handle);
+    si->type = info.type;
 
     auto func = [](std::vector<std::any>& args)
     {
-        auto handle = std::any_cast<shader_handle>(args[0]);
-        auto source = std::any_cast<const char*>(args[1]);
+        auto& handle = std::any_cast<shader_handle&>(args[0]);
+        auto& source = std::any_cast<std::string&>(args[1]);
+        auto& binary = std::any_cast<std::vector<uint8_t>&>(args[2]);
     
         auto si = pikango_internal::obtain_handle_object(handle);
+        auto source_ptr = source.c_str();
+
+        //Load the cached program, the driver could reject it though
+        if (binary.size() != 0)
+        {
+            GLuint program = glCreateProgram();
+            glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+
+            if (apply_program_binary(program, binary))
+            {
+                si->id = program;
+                si->status = shader_compile_status::ready;
+                notify_shaders_ready();
+                return;
+            }
+
+            glDeleteProgram(program);
+        }
     
         //Create And Compile Shader
         GLuint shader = glCreateShader(get_format_shader(si->type));
-        glShaderSource(shader, 1, &source, NULL);
+        glShaderSource(shader, 1, &source_ptr, NULL);
         glCompileShader(shader);
     
-        int success;
-        char infoLog[512];
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);  
-        if (!success)
-        {
-            glGetShaderInfoLog(shader, 512, NULL, infoLog);
-            log_error(infoLog);
-        }
-    
         //Create Separatable Program
+        //Linking right away does not wait for the compilation, the errors are checked once it completes
         GLuint program = glCreateProgram();
         glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        if (si->binary_cache_key != 0) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(program, shader);
         glLinkProgram(program);
     
-        //Delete Shader
-        glDetachShader(program, shader);
-        glDeleteShader(shader);
-    
         si->id = program;
+        si->compiled_shader = shader;
+
+        compiling_shaders.push_back(std::move(handle));
+        poll_compiling_shaders();
     };
 
-    //waiting for execution so the source can be freed
-    //waiting is bad, but there is no other way - other api's would just compile shader
-    //while opengl require us to execute such task on our execution thread
-    enqueue_task_and_wait(func, {handle, info.source}, pikango::queue_type::general);
+    //the source is copied, so the caller can free it right away
+    std::string source = info.source;
+
+    //the file is read here, the execution thread only gives it to the driver
+    std::vector<uint8_t> binary;
+    if (is_program_binary_cache_enabled())
+    {
+        si->binary_cache_key = get_program_binary_key(source, info.type);
+        binary = load_program_binary(si->binary_cache_key);
+    }
+
+    //dispatches on the compute queue use the program
+    enqueue_task(func, {handle, std::move(source), std::move(binary)}, pikango::queue_type::general, true);
     return handle;
 };
 
+pikango::shader_compile_status pikango::get_shader_compile_status(shader_handle target)
+{
+    auto si = pikango_internal::obtain_handle_object(target);
+    return si->status;
+}
+
+void pikango::await_shaders_ready(const std::vector<shader_handle>& targets)
+{
+    auto all_compiled = [&]
+    {
+        for (auto& target : targets)
+            if (pikango_internal::obtain_handle_object(target)->status == shader_compile_status::compiling)
+                return false;
+        return true;
+    };
+
+    if (all_compiled()) return;
+
+    shaders_ready_waiters++;
+
+    {
+        std::unique_lock<std::mutex> lock(shaders_ready_mutex);
+        shaders_ready_condition.wait(lock, all_compiled);
+    }
+
+    shaders_ready_waiters--;
+}
+
 void delete_dangling_program_pipelines(void* impl_ptr, pikango::shader_type type);
+static void forget_shader_variant(pikango_internal::shader_impl* si);
 
 pikango_internal::shader_impl::~shader_impl()
 {
-    delete_dangling_program_pipelines(this, type);
+    if (is_variant)
+        forget_shader_variant(this);
 
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto id = std::any_cast<GLuint>(args[0]);
-        glDeleteShader(id);
-    };
+    delete_dangling_program_pipelines(this, type);
 
     if (this->id != 0)
-        enqueue_task(func, {id}, pikango::queue_type::general);
+        retire_gl_name(&retired_gl_names::programs, id);
 }
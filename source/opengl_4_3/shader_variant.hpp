@@ -0,0 +1,222 @@
+#pragma once
+
+//Variants are preprocessed on the calling thread and identified by the hash of their final source
+//The registry does not own the shaders, it only gives out new references to the ones that are still alive
+struct registered_shader_variant
+{
+    pikango_internal::shader_impl*          object;
+    pikango_internal::handle_meta_block*    meta;
+};
+
+namespace {
+    std::mutex shader_variants_registry_mutex;
+    std::unordered_map<uint64_t, registered_shader_variant> shader_variants_registry;
+
+    constexpr size_t max_shader_include_depth = 32;
+};
+
+static bool starts_with_directive(const std::string& line, const char* directive, size_t& directive_end)
+{
+    size_t i = line.find_first_not_of(" \t");
+    if (i == std::string::npos || line[i] != '#') return false;
+
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == std::string::npos) return false;
+
+    size_t length = strlen(directive);
+    if (line.compare(i, length, directive) != 0) return false;
+
+    directive_end = i + length;
+    return true;
+}
+
+//Returns false if the line is not an include directive
+static bool parse_include_name(const std::string& line, std::string& name)
+{
+    size_t i;
+    if (!starts_with_directive(line, "include", i)) return false;
+
+    i = line.find_first_of("\"<", i);
+    if (i == std::string::npos) return false;
+
+    char closing = line[i] == '"' ? '"' : '>';
+    size_t end = line.find(closing, i + 1);
+    if (end == std::string::npos) return false;
+
+    name = line.substr(i + 1, end - i - 1);
+    return true;
+}
+
+static bool resolve_shader_includes(
+    const std::string& source,
+    pikango::shader_include_resolver resolver,
+    std::vector<std::string>& includes_stack,
+    std::string& output
+)
+{
+    size_t line_number = 1;
+    size_t position = 0;
+
+    while (position < source.size())
+    {
+        size_t line_end = source.find('\n', position);
+        if (line_end == std::string::npos) line_end = source.size();
+
+        std::string line = source.substr(position, line_end - position);
+        position = line_end + 1;
+        line_number++;
+
+        std::string name;
+        if (!parse_include_name(line, name))
+        {
+            output += line;
+            output += '\n';
+            continue;
+        }
+
+        if (resolver == nullptr)
+        {
+            log_error(("Shader includes \"" + name + "\" but no include resolver was given").c_str());
+            return false;
+        }
+
+        if (std::find(includes_stack.begin(), includes_stack.end(), name) != includes_stack.end())
+        {
+            log_error(("Shader include \"" + name + "\" includes itself").c_str());
+            return false;
+        }
+
+        if (includes_stack.size() >= max_shader_include_depth)
+        {
+            log_error(("Shader include \"" + name + "\" exceeds the maximum include depth of " + std::to_string(max_shader_include_depth)).c_str());
+            return false;
+        }
+
+        std::string included;
+        if (!resolver(name, included))
+        {
+            log_error(("Shader include \"" + name + "\" could not be resolved").c_str());
+            return false;
+        }
+
+        includes_stack.push_back(name);
+        bool resolved = resolve_shader_includes(included, resolver, includes_stack, output);
+        includes_stack.pop_back();
+
+        if (!resolved) return false;
+
+        //keep the line numbers in the compilation errors matching the including file
+        output += "#line " + std::to_string(line_number) + '\n';
+    }
+
+    return true;
+}
+
+//Defines have to follow the #version directive, nothing but comments can precede it
+static std::string insert_shader_defines(const std::string& source, const std::vector<pikango::shader_define>& defines)
+{
+    if (defines.size() == 0) return source;
+
+    std::string defines_text;
+    for (auto& define : defines)
+        defines_text += "#define " + define.name + ' ' + define.value + '\n';
+
+    size_t position = 0;
+    size_t line_number = 1;
+
+    while (position < source.size())
+    {
+        size_t line_end = source.find('\n', position);
+        if (line_end == std::string::npos) line_end = source.size();
+
+        size_t directive_end;
+        if (starts_with_directive(source.substr(position, line_end - position), "version", directive_end))
+        {
+            size_t insert_at = std::min(line_end + 1, source.size());
+
+            std::string result = source.substr(0, insert_at);
+            if (line_end == source.size()) result += '\n';
+
+            result += defines_text;
+            result += "#line " + std::to_string(line_number + 1) + '\n';
+            result += source.substr(insert_at);
+            return result;
+        }
+
+        position = line_end + 1;
+        line_number++;
+    }
+
+    return defines_text + "#line 1\n" + source;
+}
+
+static pikango::shader_handle find_shader_variant(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(shader_variants_registry_mutex);
+
+    auto itr = shader_variants_registry.find(key);
+    if (itr == shader_variants_registry.end()) return {};
+
+    auto& variant = itr->second;
+    return pikango_internal::try_retain_handle(variant.object, variant.meta);
+}
+
+pikango::shader_handle pikango::new_shader_variant(const shader_variant_create_info& info)
+{
+    std::vector<std::string> includes_stack;
+    std::string resolved;
+
+    if (!resolve_shader_includes(info.source, info.include_resolver, includes_stack, resolved))
+        return {};
+
+    std::string source = insert_shader_defines(resolved, info.defines);
+
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = fnv1a_hash(key, source.data(), source.size());
+    key = fnv1a_hash(key, &info.type, sizeof(info.type));
+
+    auto existing = find_shader_variant(key);
+    if (!pikango_internal::is_empty(existing)) return existing;
+
+    //created outside of the lock, the shader destructors running on the execution thread take it
+    //and creating can wait for the execution thread when its queue is full
+    auto shader = new_shader({info.type, source.c_str()});
+
+    auto si = pikango_internal::obtain_handle_object(shader);
+    si->variant_key = key;
+
+    {
+        std::lock_guard<std::mutex> lock(shader_variants_registry_mutex);
+
+        //another thread could have registered the same variant meanwhile
+        auto itr = shader_variants_registry.find(key);
+        if (itr != shader_variants_registry.end())
+        {
+            auto& variant = itr->second;
+            existing = pikango_internal::try_retain_handle(variant.object, variant.meta);
+        }
+
+        if (pikango_internal::is_empty(existing))
+        {
+            si->is_variant = true;
+
+            auto meta = (pikango_internal::handle_meta_block*)pikango_internal::get_handle_meta_block_address(shader);
+            shader_variants_registry[key] = registered_shader_variant{si, meta};
+        }
+    }
+
+    //the unused shader is released outside of the lock
+    if (!pikango_internal::is_empty(existing)) return existing;
+
+    return shader;
+}
+
+//Called by the shader destructor, the entry could already belong to a newer shader with the same source
+static void forget_shader_variant(pikango_internal::shader_impl* si)
+{
+    std::lock_guard<std::mutex> lock(shader_variants_registry_mutex);
+
+    auto itr = shader_variants_registry.find(si->variant_key);
+    if (itr != shader_variants_registry.end() && itr->second.object == si)
+        shader_variants_registry.erase(itr);
+}
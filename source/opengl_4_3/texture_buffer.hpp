@@ -16,7 +16,8 @@ struct pikango_internal::texture_buffer_impl
 
 pikango::texture_buffer_handle pikango::new_texture_buffer(const texture_buffer_create_info& info)
 {
-    auto tbi = new pikango_internal::texture_buffer_impl;
+    auto handle = pikango_internal::make_handle<pikango_internal::texture_buffer_impl>();
+    auto tbi = pikango_internal::obtain_handle_object(handle);
 
     tbi->id = 0;
 
@@ -29,15 +30,13 @@ pikango::texture_buffer_handle pikango::new_texture_buffer(const texture_buffer_
 
     tbi->mipmap = info.mipmap_layers;
 
-    auto handle = pikango_internal::make_handle(tbi);
-
     auto func = [](std::vector<std::any>& args)
     {
-        auto handle  = std::any_cast<texture_buffer_handle>(args[0]);
+        auto& handle  = std::any_cast<texture_buffer_handle&>(args[0]);
         auto tbi = pikango_internal::obtain_handle_object(handle);
 
         glGenTextures(1, &tbi->id);
-        glBindTexture(tbi->type, tbi->id);
+        gl_bind_texture(textures_operation_unit, tbi->type, tbi->id);
 
         switch (tbi->type)
         {
@@ -61,19 +60,55 @@ pikango::texture_buffer_handle pikango::new_texture_buffer(const texture_buffer_
         }
     };
 
-    enqueue_task(func, {handle}, pikango::queue_type::general);
+    enqueue_task(func, {handle}, pikango::queue_type::general, true);
     return handle;
 };
 
 pikango_internal::texture_buffer_impl::~texture_buffer_impl()
 {
-    auto func = [](std::vector<std::any>& args)
+    if (id != 0) retire_gl_name(&retired_gl_names::textures, id);
+}
+
+static size_t get_texture_source_format_components(pikango::texture_source_format format)
+{
+    switch (format)
     {
-        auto id = std::any_cast<GLuint>(args[0]);
-        glDeleteTextures(1, &id);
-    };
+    case pikango::texture_source_format::r:     return 1;
+    case pikango::texture_source_format::rg:    return 2;
+    case pikango::texture_source_format::rgb:   return 3;
+    case pikango::texture_source_format::rgba:  return 4;
+    }
+
+    //Will never happen
+    return 4;
+}
+
+//Size of the source data, with the rows aligned as GL_UNPACK_ALIGNMENT of 4 reads them
+//the last row is not padded, the caller memory could end right after it
+//dimensions the texture type does not upload are not counted
+static size_t get_texture_source_size(GLenum type, pikango::texture_source_format format, size_t dim1, size_t dim2, size_t dim3)
+{
+    constexpr size_t row_alignment = 4;
 
-    if (id != 0) enqueue_task(func, {id}, pikango::queue_type::general);
+    switch (type)
+    {
+    case GL_TEXTURE_1D:
+        dim2 = 1;
+        dim3 = 1;
+        break;
+
+    case GL_TEXTURE_1D_ARRAY:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_CUBE_MAP:
+        dim3 = 1;
+        break;
+    }
+
+    size_t row_size = std::max<size_t>(dim1, 1) * get_texture_source_format_components(format);
+    size_t row_stride = (row_size + row_alignment - 1) & ~(row_alignment - 1);
+    size_t rows = std::max<size_t>(dim2, 1) * std::max<size_t>(dim3, 1);
+
+    return row_stride * (rows - 1) + row_size;
 }
 
 void pikango::cmd::write_texture_buffer(
@@ -89,23 +124,44 @@ void pikango::cmd::write_texture_buffer(
     size_t                  dim3
 )
 {
-    auto func = [](std::vector<std::any>& args)
+    struct arguments
     {
-        auto handle = std::any_cast<texture_buffer_handle>(args[0]);
+        pikango_internal::texture_buffer_impl* tbi;
 
-        auto mipmap = std::any_cast<size_t>(args[1]);
-        auto format = std::any_cast<GLuint>(args[2]);
-        auto data   = std::any_cast<void*>(args[3]);
+        GLint   mipmap;
+        GLenum  format;
 
-        auto off_1 = std::any_cast<size_t>(args[4]);
-        auto off_2 = std::any_cast<size_t>(args[5]);
-        auto off_3 = std::any_cast<size_t>(args[6]);
+        //either the data copied into the command buffer or the staging block it was copied to
+        const uint8_t*  data;
+        staging_block*  block;
+        size_t          staging_offset;
 
-        auto dim1 = std::any_cast<size_t>(args[7]);
-        auto dim2 = std::any_cast<size_t>(args[8]);
-        auto dim3 = std::any_cast<size_t>(args[9]);
+        GLint   off_1;
+        GLint   off_2;
+        GLint   off_3;
 
-        auto tbi = pikango_internal::obtain_handle_object(handle);
+        GLsizei dim1;
+        GLsizei dim2;
+        GLsizei dim3;
+    };
+
+    auto func = [](arguments& args)
+    {
+        auto tbi = args.tbi;
+        apply_compute_barrier();
+
+        //staging blocks are read as pixel unpack buffers, the data is then the offset in them
+        //so the driver copies to the texture in the background instead of from the client memory right away
+        const void* data = args.data;
+        GLuint unpack_buffer = 0;
+
+        if (args.block != nullptr)
+        {
+            unpack_buffer = args.block->buffer;
+            data = (const void*)(uintptr_t)args.staging_offset;
+        }
+
+        gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, unpack_buffer);
 
         constexpr static GLuint cubemap_faces[] = {
             GL_TEXTURE_CUBE_MAP_POSITIVE_X,
@@ -119,60 +175,74 @@ void pikango::cmd::write_texture_buffer(
         switch (tbi->type)
         {
         case GL_TEXTURE_1D:
-            glBindTexture(tbi->type, tbi->id);
+            gl_bind_texture(textures_operation_unit, tbi->type, tbi->id);
             glTexSubImage1D(
-                tbi->type, mipmap, 
-                off_1, 
-                dim1, 
-                format, GL_UNSIGNED_BYTE, data
+                tbi->type, args.mipmap, 
+                args.off_1, 
+                args.dim1, 
+                args.format, GL_UNSIGNED_BYTE, data
             );
             break;
 
         case GL_TEXTURE_1D_ARRAY:
         case GL_TEXTURE_2D:
-            glBindTexture(tbi->type, tbi->id);
+            gl_bind_texture(textures_operation_unit, tbi->type, tbi->id);
             glTexSubImage2D(
-                tbi->type, mipmap, 
-                off_1, off_2, 
-                dim1, dim2, 
-                format, GL_UNSIGNED_BYTE, data
+                tbi->type, args.mipmap, 
+                args.off_1, args.off_2, 
+                args.dim1, args.dim2, 
+                args.format, GL_UNSIGNED_BYTE, data
             );
             break;
 
         case GL_TEXTURE_2D_ARRAY:
         case GL_TEXTURE_3D:
-            glBindTexture(tbi->type, tbi->id);
+            gl_bind_texture(textures_operation_unit, tbi->type, tbi->id);
             glTexSubImage3D(
-                tbi->type, mipmap, 
-                off_1, off_2, off_3, 
-                dim1, dim2, dim3, 
-                format, GL_UNSIGNED_BYTE, data
+                tbi->type, args.mipmap, 
+                args.off_1, args.off_2, args.off_3, 
+                args.dim1, args.dim2, args.dim3, 
+                args.format, GL_UNSIGNED_BYTE, data
             );
             break;
 
         case GL_TEXTURE_CUBE_MAP:
-            auto cubemap_face = cubemap_faces[off_3 % 6];
-            glBindTexture(cubemap_face, tbi->id);
+            auto cubemap_face = cubemap_faces[args.off_3 % 6];
+            gl_bind_texture(textures_operation_unit, tbi->type, tbi->id);
             glTexSubImage2D(
-                cubemap_face, mipmap, 
-                off_1, off_2, 
-                dim1, dim2, 
-                format, GL_UNSIGNED_BYTE, data
+                cubemap_face, args.mipmap, 
+                args.off_1, args.off_2, 
+                args.dim1, args.dim2, 
+                args.format, GL_UNSIGNED_BYTE, data
             );
             break;
         }
     };
 
-    record_task(func, {
-        target,
-        mipmap_layer,
+    auto cbi = pikango_internal::obtain_handle_object(recorded_command_buffer);
+    auto tbi = pikango_internal::obtain_handle_object(target);
+    size_t data_size = get_texture_source_size(tbi->type, source_format, dim1, dim2, dim3);
+
+    const uint8_t* inline_data = nullptr;
+    std::pair<staging_block*, size_t> staged = {nullptr, 0};
+
+    if (data_size <= inline_payload_threshold)
+        inline_data = cbi->stream.payloads.copy(data, data_size);
+    else
+        staged = stage_upload(cbi->stream, data, data_size);
+
+    record_task("write_texture_buffer", func, arguments{
+        retain_handle_object(target),
+        (GLint)mipmap_layer,
         get_texture_source_format(source_format),
-        data,
-        off_1,
-        off_2,
-        off_3,
-        dim1,
-        dim2,
-        dim3
+        inline_data,
+        staged.first,
+        staged.second,
+        (GLint)off_1,
+        (GLint)off_2,
+        (GLint)off_3,
+        (GLsizei)dim1,
+        (GLsizei)dim2,
+        (GLsizei)dim3
     });
 }
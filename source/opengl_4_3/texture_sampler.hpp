@@ -6,11 +6,11 @@ struct pikango_internal::texture_sampler_impl
 
 pikango::texture_sampler_handle pikango::new_texture_sampler(const texture_sampler_create_info& info)
 {
-    auto handle = pikango_internal::make_handle(new pikango_internal::texture_sampler_impl);
+    auto handle = pikango_internal::make_handle<pikango_internal::texture_sampler_impl>();
 
     auto func = [](std::vector<std::any>& args)
     {
-        auto handle = std::any_cast<pikango::texture_sampler_handle>(args[0]);
+        auto& handle = std::any_cast<pikango::texture_sampler_handle&>(args[0]);
         auto info   = std::any_cast<texture_sampler_create_info>(args[1]);
 
         auto tsi = pikango_internal::obtain_handle_object(handle);
@@ -31,11 +31,5 @@ pikango::texture_sampler_handle pikango::new_texture_sampler(const texture_sampl
 
 pikango_internal::texture_sampler_impl::~texture_sampler_impl()
 {
-    auto func = [](std::vector<std::any>& args)
-    {
-        auto id = std::any_cast<GLuint>(args[0]);
-        glDeleteSamplers(1, &id);
-    };
-
-    if (id != 0) enqueue_task(func, {id}, pikango::queue_type::general);
+    if (id != 0) retire_gl_name(&retired_gl_names::samplers, id);
 }
@@ -0,0 +1,257 @@
+#pragma once
+
+//The transfer queue can run on its own thread, with a context sharing the objects with the main one
+//Context state, the vertex array and the pending fences are kept per thread, the objects themselves are shared
+//After each batch the transfer thread inserts a sync, the execution thread waits for it on the gpu before
+//its next batch, so its work is ordered after the transfers issued so far, and binds the objects again to see their content
+//In the other direction, buffers and textures are created by the execution thread, which inserts a sync after the batches
+//creating some. A transfer task waits until the creations enqueued before its submission were executed, then for that sync
+//Pipelines and frame buffers are not shared between contexts, so only transfer commands can be submitted to the queue
+
+namespace {
+    std::thread* opengl_transfer_thread = nullptr;
+
+    //sync inserted after the latest batch of the transfer thread
+    std::mutex              transfer_sync_mutex;
+    GLsync                  transfer_sync = nullptr;
+    std::atomic<uint64_t>   transfer_batches_executed{0};
+
+    //execution thread only
+    uint64_t                transfer_batches_awaited = 0;
+
+    //sync inserted after the latest batch of the execution thread that created some objects
+    std::mutex                  creation_sync_mutex;
+    std::condition_variable     creation_sync_condition;
+    GLsync                      creation_sync = nullptr;
+    uint64_t                    objects_creations_published = 0;
+
+    //transfer thread only
+    uint64_t                    objects_creations_awaited = 0;
+};
+
+static bool transfer_thread_has_work()
+{
+    return transfer_queue.pending != 0 || should_transfer_thread_terminate;
+}
+
+//Transfer thread
+static void publish_transfer_sync()
+{
+    GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    std::lock_guard<std::mutex> lock(transfer_sync_mutex);
+
+    if (transfer_sync != nullptr)
+        glDeleteSync(transfer_sync);
+
+    transfer_sync = sync;
+    transfer_batches_executed++;
+}
+
+//Execution thread
+static void await_transfer_thread()
+{
+    if (transfer_batches_awaited == transfer_batches_executed) return;
+
+    {
+        std::lock_guard<std::mutex> lock(transfer_sync_mutex);
+        transfer_batches_awaited = transfer_batches_executed;
+        glWaitSync(transfer_sync, 0, GL_TIMEOUT_IGNORED);
+    }
+
+    //objects changed by the other context are only guaranteed to be up to date once bound again
+    invalidate_gl_state();
+    cmd_bindings::invalidate();
+}
+
+//Execution thread
+static void release_transfer_sync()
+{
+    {
+        std::lock_guard<std::mutex> lock(transfer_sync_mutex);
+
+        if (transfer_sync != nullptr)
+            glDeleteSync(transfer_sync);
+
+        transfer_sync = nullptr;
+        transfer_batches_awaited = transfer_batches_executed;
+    }
+
+    std::lock_guard<std::mutex> lock(creation_sync_mutex);
+
+    if (creation_sync != nullptr)
+        glDeleteSync(creation_sync);
+
+    creation_sync = nullptr;
+}
+
+//Execution thread
+//Called after each batch, the objects ids written by the batch are published with the counter
+static void publish_objects_creations()
+{
+    uint64_t executed = objects_creations_executed;
+    if (executed == objects_creations_published) return;
+
+    //without the transfer thread the tasks are ordered by the execution thread itself
+    //the thread flushes the earlier creations when it starts
+    if (!transfer_thread_running)
+    {
+        std::lock_guard<std::mutex> lock(creation_sync_mutex);
+        objects_creations_published = executed;
+        return;
+    }
+
+    GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    {
+        std::lock_guard<std::mutex> lock(creation_sync_mutex);
+
+        if (creation_sync != nullptr)
+            glDeleteSync(creation_sync);
+
+        creation_sync = sync;
+        objects_creations_published = executed;
+    }
+
+    creation_sync_condition.notify_one();
+}
+
+//Transfer thread
+static void await_objects_creations(const enqueued_task& task)
+{
+    if (task.required_creations <= objects_creations_awaited) return;
+
+    std::unique_lock<std::mutex> lock(creation_sync_mutex);
+    creation_sync_condition.wait(lock, [&] { return objects_creations_published >= task.required_creations; });
+
+    if (creation_sync != nullptr)
+        glWaitSync(creation_sync, 0, GL_TIMEOUT_IGNORED);
+
+    objects_creations_awaited = objects_creations_published;
+
+    //names cached before could have been deleted and reused by the created objects
+    invalidate_gl_state();
+}
+
+//Transfer thread
+static void initialize_transfer_context()
+{
+    invalidate_gl_state();
+
+    //vertex arrays are not shared, binding index buffers needs one
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    if (error_callback)
+    {
+        glEnable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(gl_log_error, 0);
+    }
+}
+
+//Transfer thread
+static void release_transfer_context()
+{
+    //everything issued has completed, so the fences can be signaled
+    glFinish();
+    release_pending_fences();
+
+    glDeleteVertexArrays(1, &VAO);
+}
+
+static void opengl_transfer_thread_logic(pikango::opengl_thread_task make_context_current, std::vector<std::any> args)
+{
+    make_context_current(args);
+    initialize_transfer_context();
+
+    //the tasks taken by the execution thread before are executed first
+    auto& batch = transfer_queue.taken;
+
+    while (true)
+    {
+        wait_for_tasks(transfer_thread_sleep, transfer_thread_has_work, has_pending_fences, poll_pending_fences);
+
+        if (should_transfer_thread_terminate && transfer_queue.pending == 0) break;
+
+        transfer_queue.tasks.drain(batch, execution_queue_capacity);
+
+        for (auto& task : transfer_queue.spilled)
+            batch.push_back(std::move(task));
+        transfer_queue.spilled.clear();
+
+        if (batch.size() == 0) continue;
+
+        //names cached by the previous batch could have been deleted and reused by the execution thread
+        invalidate_gl_state();
+
+        auto batch_start = scheduler_clock::now();
+
+        for (auto& task : batch)
+        {
+            await_objects_creations(task);
+            execute_queue_task(transfer_queue, task, scheduler_clock::now());
+        }
+
+        //inserted before the tasks are released, so it covers the staging blocks they retire
+        publish_transfer_sync();
+
+        auto busy = std::chrono::duration_cast<std::chrono::microseconds>(scheduler_clock::now() - batch_start).count();
+        add_queue_metric(transfer_queue.busy_microseconds, busy);
+
+        size_t executed = batch.size();
+        batch.clear();
+
+        if (has_pending_fences())
+            poll_pending_fences();
+
+        if ((transfer_queue.pending -= executed) == 0)
+            notify_queue_empty(transfer_queue);
+
+        if (all_queues_empty())
+            notify_all_queues_empty();
+    }
+
+    release_transfer_context();
+}
+
+void pikango::OPENGL_ONLY_start_transfer_thread(opengl_thread_task make_context_current, std::vector<std::any>&& args)
+{
+    //Started by the execution thread, so it never takes tasks from the transfer queue afterwards
+    auto func = [](std::vector<std::any>& args)
+    {
+        if (transfer_thread_running) return;
+
+        auto task = std::any_cast<opengl_thread_task>(args[0]);
+        auto& task_args = std::any_cast<std::vector<std::any>&>(args[1]);
+
+        //the objects created so far are complete before the other context uses them
+        glFinish();
+        publish_objects_creations();
+
+        should_transfer_thread_terminate = false;
+        opengl_transfer_thread = new std::thread{opengl_transfer_thread_logic, task, std::move(task_args)};
+
+        transfer_thread_id = opengl_transfer_thread->get_id();
+        transfer_thread_running = true;
+    };
+
+    enqueue_task_and_wait(func, {make_context_current, std::move(args)}, pikango::queue_type::general);
+}
+
+static void stop_opengl_transfer_thread()
+{
+    if (!transfer_thread_running) return;
+
+    should_transfer_thread_terminate = true;
+    wake_thread(transfer_thread_sleep);
+
+    opengl_transfer_thread->join();
+
+    delete opengl_transfer_thread;
+    opengl_transfer_thread = nullptr;
+
+    //the remaining transfer tasks are executed by the execution thread again
+    transfer_thread_running = false;
+}
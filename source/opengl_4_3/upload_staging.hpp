@@ -0,0 +1,354 @@
+#pragma once
+
+//Data written with commands is copied into staging memory when the command is recorded
+//so the caller can free it right away, and the execution thread only issues the gpu side copies
+//Command buffers take staging blocks from a shared pool and bump allocate them, a block returns to the pool
+//once its command buffer is rerecorded or destroyed and a sync inserted after its last use has signaled
+//Blocks are buffers read with glCopyBufferSubData or as pixel unpack buffers, so the driver copies from them
+//in the background. With buffer storage they stay persistently mapped, otherwise they are mapped while
+//in the pool and unmapped when their command buffer is first executed
+//Blocks of a stream grow from small to large ones, so streams writing little data do not hold much memory
+//Buffers are created on the execution thread, a recording thread that finds no free block of the size
+//it needs waits for the whole general queue. The pool is grown in the background once its last block of a size is taken
+
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    #define PIKANGO_GL_BUFFER_STORAGE
+#endif
+
+struct staging_block
+{
+    GLuint      buffer = 0;
+    uint8_t*    memory = nullptr;   //null while the buffer is unmapped
+    size_t      size = 0;
+};
+
+struct fenced_staging_blocks
+{
+    GLsync                      sync;
+    std::vector<staging_block*> blocks;
+};
+
+namespace {
+    //smaller data is copied into the command buffer itself and uploaded with glBufferSubData or glTexSubImage
+    constexpr size_t inline_payload_threshold = 4 * 1024;
+
+    //blocks have power of two sizes, so the blocks of streamed textures are reused
+    //the first block of a stream is the smallest, each next one is twice as large up to the block size
+    //larger data gets a block of the next power of two size
+    constexpr size_t staging_min_block_size = 64 * 1024;
+    constexpr size_t staging_block_size = 4 * 1024 * 1024;
+    constexpr size_t staging_initial_blocks = 2;
+    constexpr size_t staging_allocation_alignment = 16;
+
+    //blocks returning to a pool holding more than this are destroyed
+    constexpr size_t staging_pool_max_bytes = 128 * 1024 * 1024;
+
+    //set once the context is initialized
+    bool buffer_storage_supported = false;
+
+    std::mutex                      staging_pool_mutex;
+    std::vector<staging_block*>     free_staging_blocks;
+    size_t                          free_staging_bytes = 0;
+    bool                            staging_pool_growing = false;
+    std::vector<staging_block*>     retired_staging_blocks;
+    std::atomic<bool>               any_staging_blocks_retired = false;
+
+    //blocks waiting for the gpu to finish reading them, execution thread only
+    std::vector<fenced_staging_blocks>  fenced_staging_blocks_groups;
+    std::vector<staging_block*>         fenced_staging_blocks_taken;
+};
+
+//Execution thread
+//The gpu is done with the block, so the old content does not have to be synchronized
+static void map_staging_block(staging_block* block)
+{
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, block->buffer);
+    block->memory = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, block->size, flags);
+}
+
+//Execution thread
+static void create_staging_buffer(staging_block* block)
+{
+    glGenBuffers(1, &block->buffer);
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, block->buffer);
+
+#ifdef PIKANGO_GL_BUFFER_STORAGE
+    if (buffer_storage_supported)
+    {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glBufferStorage(GL_COPY_WRITE_BUFFER, block->size, nullptr, flags);
+        block->memory = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, block->size, flags);
+        return;
+    }
+#endif
+
+    glBufferData(GL_COPY_WRITE_BUFFER, block->size, nullptr, GL_STREAM_DRAW);
+    map_staging_block(block);
+}
+
+static staging_block* create_staging_block(size_t size)
+{
+    auto block = new staging_block;
+    block->size = size;
+
+    auto func = [](std::vector<std::any>& args)
+    {
+        create_staging_buffer(std::any_cast<staging_block*>(args[0]));
+    };
+
+    //the pool only grows when more data is in flight than ever before
+    if (std::this_thread::get_id() == execution_thread_id)
+    {
+        create_staging_buffer(block);
+        count_objects_creation();
+    }
+    else
+        enqueue_task_and_wait(func, {block}, pikango::queue_type::general, true);
+
+    return block;
+}
+
+//Execution thread
+static void destroy_staging_block(staging_block* block)
+{
+    //deleting a mapped buffer unmaps it
+    retire_gl_name(&retired_gl_names::buffers, block->buffer);
+    delete block;
+}
+
+//Execution thread
+static void recycle_staging_block(staging_block* block)
+{
+    if (block->memory == nullptr)
+        map_staging_block(block);
+
+    std::lock_guard<std::mutex> lock(staging_pool_mutex);
+
+    if (free_staging_bytes + block->size > staging_pool_max_bytes)
+    {
+        destroy_staging_block(block);
+        return;
+    }
+
+    free_staging_blocks.push_back(block);
+    free_staging_bytes += block->size;
+}
+
+static bool has_free_staging_block(size_t block_size)
+{
+    for (auto block : free_staging_blocks)
+        if (block->size == block_size) return true;
+
+    return false;
+}
+
+//Creates a block for the pool without waiting, so the next recording taking a block of the size does not stall
+static void grow_staging_pool(size_t block_size)
+{
+    auto func = [](std::vector<std::any>& args)
+    {
+        auto block = new staging_block;
+        block->size = std::any_cast<size_t>(args[0]);
+        create_staging_buffer(block);
+
+        recycle_staging_block(block);
+
+        std::lock_guard<std::mutex> lock(staging_pool_mutex);
+        staging_pool_growing = false;
+    };
+
+    std::vector<std::any> args = {block_size};
+
+    if (std::this_thread::get_id() == execution_thread_id)
+    {
+        func(args);
+        count_objects_creation();
+    }
+    else
+        enqueue_task(func, std::move(args), pikango::queue_type::general, true);
+}
+
+static staging_block* acquire_staging_block(size_t size)
+{
+    size_t block_size = staging_min_block_size;
+    while (block_size < size) block_size *= 2;
+
+    staging_block* found = nullptr;
+    bool grow = false;
+
+    {
+        std::lock_guard<std::mutex> lock(staging_pool_mutex);
+
+        for (size_t i = free_staging_blocks.size(); i-- > 0;)
+        {
+            auto block = free_staging_blocks[i];
+            if (block->size != block_size) continue;
+
+            free_staging_blocks.erase(free_staging_blocks.begin() + i);
+            free_staging_bytes -= block->size;
+            found = block;
+            break;
+        }
+
+        //one block is created at a time, blocks of sizes taken often are created first
+        grow = !staging_pool_growing && !has_free_staging_block(block_size);
+        if (grow) staging_pool_growing = true;
+    }
+
+    if (grow)
+        grow_staging_pool(block_size);
+
+    if (found != nullptr)
+        return found;
+
+    return create_staging_block(block_size);
+}
+
+//Copies the data to the staging memory of the stream, returns the block and offset it was put at
+static std::pair<staging_block*, size_t> stage_upload(command_stream& stream, const void* data, size_t size)
+{
+    size_t offset = (stream.staging_offset + staging_allocation_alignment - 1) & ~(staging_allocation_alignment - 1);
+
+    if (stream.staging_blocks.size() == 0 || offset + size > stream.staging_blocks.back()->size)
+    {
+        size_t block_size = staging_min_block_size;
+        if (stream.staging_blocks.size() != 0)
+            block_size = std::min(stream.staging_blocks.back()->size * 2, staging_block_size);
+
+        stream.staging_blocks.push_back(acquire_staging_block(std::max(block_size, size)));
+        offset = 0;
+    }
+
+    auto block = stream.staging_blocks.back();
+    memcpy(block->memory + offset, data, size);
+
+    stream.staging_offset = offset + size;
+    stream.staging_bytes += size;
+    return {block, offset};
+}
+
+//Execution thread
+static void upload_from_staging(staging_block* block, size_t staging_offset, GLuint target, GLintptr offset, GLsizeiptr size)
+{
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, target);
+    gl_bind_buffer(GL_COPY_READ_BUFFER, block->buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, staging_offset, offset, size);
+}
+
+//Execution thread
+//Buffers can not be read by the gpu while mapped, persistent mappings excepted
+static void unmap_staging_blocks(std::vector<staging_block*>& blocks)
+{
+    if (buffer_storage_supported) return;
+
+    for (auto block : blocks)
+    {
+        if (block->memory == nullptr) continue;
+
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, block->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        block->memory = nullptr;
+    }
+}
+
+//Called when the stream is cleared or destroyed, the blocks could still be read by the gpu
+static void retire_staging_blocks(std::vector<staging_block*>& blocks)
+{
+    if (blocks.size() == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(staging_pool_mutex);
+        retired_staging_blocks.insert(retired_staging_blocks.end(), blocks.begin(), blocks.end());
+        any_staging_blocks_retired = true;
+    }
+
+    blocks.clear();
+}
+
+//Execution thread
+//Called between the batches, so everything that could use the retired blocks was already issued
+static void fence_retired_staging_blocks()
+{
+    if (!any_staging_blocks_retired) return;
+
+    {
+        std::lock_guard<std::mutex> lock(staging_pool_mutex);
+        std::swap(retired_staging_blocks, fenced_staging_blocks_taken);
+        any_staging_blocks_retired = false;
+    }
+
+    //blocks retired by the transfer thread were published with its sync before, the fence has to follow it
+    //awaited after taking the blocks, so it covers every batch that retired some of them
+    await_transfer_thread();
+
+    fenced_staging_blocks group;
+    group.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    group.blocks = std::move(fenced_staging_blocks_taken);
+    fenced_staging_blocks_taken.clear();
+    fenced_staging_blocks_groups.push_back(std::move(group));
+
+    glFlush();
+}
+
+//Execution thread
+static bool has_fenced_staging_blocks()
+{
+    return fenced_staging_blocks_groups.size() != 0;
+}
+
+//Execution thread
+//Syncs signal in order, so groups are checked from the oldest
+static void poll_fenced_staging_blocks()
+{
+    size_t signaled = 0;
+
+    for (auto& group : fenced_staging_blocks_groups)
+    {
+        GLenum status = glClientWaitSync(group.sync, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+        glDeleteSync(group.sync);
+
+        for (auto block : group.blocks)
+            recycle_staging_block(block);
+
+        signaled++;
+    }
+
+    fenced_staging_blocks_groups.erase(fenced_staging_blocks_groups.begin(), fenced_staging_blocks_groups.begin() + signaled);
+}
+
+//Execution thread
+static void initialize_upload_staging()
+{
+    std::lock_guard<std::mutex> lock(staging_pool_mutex);
+
+    for (size_t i = 0; i < staging_initial_blocks; i++)
+        free_staging_blocks.push_back(create_staging_block(staging_block_size));
+
+    free_staging_bytes = staging_initial_blocks * staging_block_size;
+}
+
+//Execution thread
+//Blocks still owned by command buffers are left to them
+static void release_upload_staging()
+{
+    for (auto& group : fenced_staging_blocks_groups)
+    {
+        glDeleteSync(group.sync);
+        for (auto block : group.blocks) destroy_staging_block(block);
+    }
+    fenced_staging_blocks_groups.clear();
+
+    std::lock_guard<std::mutex> lock(staging_pool_mutex);
+
+    for (auto block : retired_staging_blocks)   destroy_staging_block(block);
+    for (auto block : free_staging_blocks)      destroy_staging_block(block);
+
+    retired_staging_blocks.clear();
+    free_staging_blocks.clear();
+    free_staging_bytes = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+
+//Pool of same sized memory blocks, carved out of bigger slabs
+//Freed blocks are kept on an intrusive free list and reused by the next allocations
+template<size_t block_size, size_t block_alignment>
+class slab_pool
+{
+private:
+    static constexpr size_t blocks_per_slab = 64;
+
+    union slot
+    {
+        slot* next;
+        alignas(block_alignment) unsigned char storage[block_size];
+    };
+
+    std::mutex mutex;
+    slot* free_list = nullptr;
+    std::vector<std::unique_ptr<slot[]>> slabs;
+
+    void grow()
+    {
+        slabs.emplace_back(new slot[blocks_per_slab]);
+        auto slab = slabs.back().get();
+
+        for (size_t i = 0; i < blocks_per_slab; i++)
+        {
+            slab[i].next = free_list;
+            free_list = &slab[i];
+        }
+    }
+
+public:
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (free_list == nullptr)
+            grow();
+
+        slot* block = free_list;
+        free_list = block->next;
+        return block;
+    }
+
+    void release(void* block)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto freed = static_cast<slot*>(block);
+        freed->next = free_list;
+        free_list = freed;
+    }
+
+    //Pools are never destroyed, handles stored in static objects may outlive them otherwise
+    static slab_pool& get()
+    {
+        static slab_pool* pool = new slab_pool;
+        return *pool;
+    }
+};